@@ -8,10 +8,18 @@
  */
 /* Includes ******************************************************************/
 #include "DSP.h"
+#include "profile.h"
 #include <Arduino.h>
 
 /* Defines *******************************************************************/
 
+// Kernels in DSP_avr.S take the place of these, which keep a _c suffix
+#if defined(FPDSP_AVR_ASM)
+#define FPDSP_C(NAME) NAME##_c
+#else
+#define FPDSP_C(NAME) NAME
+#endif
+
 /* Types *********************************************************************/
 
 /* Interfaces ****************************************************************/
@@ -68,8 +76,18 @@ Q_15 cosine_table( BAM8 x )
   return pgm_read_word(&COSINE_TABLE[x%COSINE_TABLE_SIZE]);
 }
 
-Q16_15 Q15_MAC( Q_15* a, Q_15* b, int16_t count)
+Q_15 cosine_lerp( BAM16 angle )
 {
+  BAM8 index = BAM16toBAM8( angle );
+  int32_t a = cosine_table( index );
+  int32_t b = cosine_table( index + 1 );
+
+  return (Q_15)(a + (((b - a) * (angle & 0xFF)) >> 8));
+}
+
+Q16_15 FPDSP_C(Q15_MAC)( Q_15* a, Q_15* b, int16_t count)
+{
+  PROFILE_BEGIN(Q15_MAC);
   Q16_15 total=0;
   //for(int i=0; i<count; ++i)
   while(count--)
@@ -77,9 +95,52 @@ Q16_15 Q15_MAC( Q_15* a, Q_15* b, int16_t count)
     total += (((Q16_15)(*a++) * (Q16_15)(*b++)) >>8);
   }
 
+  PROFILE_END(Q15_MAC);
   return ( total + (1 << 6)) >> 7;
 }
 
+Q16_15 fixed_log2( uint32_t x )
+{
+  if( 0 == x )
+  {
+    x = 1;
+  }
+
+  // Integer part is the position of the most significant bit
+  int16_t exponent = 31;
+  while( !(x & 0x80000000UL) )
+  {
+    x <<= 1;
+    --exponent;
+  }
+
+  // Fractional part: squaring the mantissa on [1..2) doubles its log, so
+  // each time it crosses 2 another bit of the log is a 1.
+  uint32_t m = x >> 16; // UQ1_15
+  Q16_15 result = (Q16_15)exponent << 15;
+  for( int i=14; i>=0; --i)
+  {
+    m = (m * m) >> 15;
+    if( m >= 0x10000UL )
+    {
+      m >>= 1;
+      result |= (Q16_15)1 << i;
+    }
+  }
+
+  return result;
+}
+
+Q16_15 power_ratio_dB( uint32_t num, uint32_t den )
+{
+  // 10*log10(x) = log2(x) * 10*log10(2)
+  // hex(10*log10(2)*0x8000+0.5)
+  const int32_t TEN_LOG10_2 = 0x18152;
+  int32_t diff = fixed_log2( num ) - fixed_log2( den );
+
+  return (Q16_15)((((int64_t)diff * TEN_LOG10_2) + (1 << 14)) >> 15);
+}
+
   // Initialization of tables of constants used by CORDIC
   // need a table of arctangents of negative powers of two:
   // hex(arctan(2^(-index))*0x8000/pi+0.5)
@@ -116,8 +177,9 @@ Q16_15 Q15_MAC( Q_15* a, Q_15* b, int16_t count)
     0x000A, 0x0005, 0x0003, 0x0001,
   };
 
-extern "C" Complex16 CORDIC16_rotate( BAM16 angle, Complex16 vector )
+extern "C" Complex16 FPDSP_C(CORDIC16_rotate)( BAM16 angle, Complex16 vector )
 {
+  PROFILE_BEGIN(CORDIC16_rotate);
   // Kvalues compensate for gain from CORDIC.
   // hex(0.5+0x8000*1/sqrt(1+(2^(-2*(0))))*1/sqrt(1+(2^(-2*(1))))*1/sqrt(1+(2^(-2*(2))))*1/sqrt(1+(2^(-2*(3))))*1/sqrt(1+(2^(-2*(4))))*1/sqrt(1+(2^(-2*(5))))*1/sqrt(1+(2^(-2*(6))))*1/sqrt(1+(2^(-2*(7))))*1/sqrt(1+(2^(-2*(8))))*1/sqrt(1+(2^(-2*(9)))))
   // and a table of products of reciprocal lengths of vectors [1, 2^-2j]:
@@ -180,6 +242,7 @@ extern "C" Complex16 CORDIC16_rotate( BAM16 angle, Complex16 vector )
   y=(y+0x4000) >> 15;
   y=constrain(y,-Q15_ONE, Q15_ONE);
 
+  PROFILE_END(CORDIC16_rotate);
   return { (Q_15)x , (Q_15)y};
 
 }
@@ -189,8 +252,9 @@ extern "C" Complex16 CORDIC16_polar2rect( Polar16 vector )
   return CORDIC16_rotate(vector.phase, {vector.mag, 0});
 }
 
-extern "C" Polar16 CORDIC16_rect2polar( Complex16 vector )
+extern "C" Polar16 FPDSP_C(CORDIC16_rect2polar)( Complex16 vector )
 {
+  PROFILE_BEGIN(CORDIC16_rect2polar);
   // Determine angle by rotating based on y value.
   // when y==0 mag=x, phase = -angle
   // see CORDIC16_rotate for wher K comes from
@@ -231,12 +295,14 @@ extern "C" Polar16 CORDIC16_rect2polar( Complex16 vector )
   x=(x+0x4000) >> 15;
   x=constrain(x,-Q15_ONE, Q15_ONE);
 
+  PROFILE_END(CORDIC16_rect2polar);
   return { (Q_15)x , (BAM16)(angle32 >>16) };
 
 }
 
 Q16_15 powerMeasurement_inphase( const Q_15* src, BAM16 freq, BAM16 phase, int N)
 {
+  PROFILE_BEGIN(powerMeasurement_inphase);
   Q16_15 sum = 0;
   BAM16 angle=phase;
   for( int j=0; j<N; ++j)
@@ -245,32 +311,66 @@ Q16_15 powerMeasurement_inphase( const Q_15* src, BAM16 freq, BAM16 phase, int N
     sum += ((Q16_15)tmp.cos * (Q16_15)(*src++))>>8;
     angle+=freq;
   }
+  PROFILE_END(powerMeasurement_inphase);
   return (sum + (1 << 6)) >> 7;
 }
 
 Q16_15 powerMeasurement_magnitude( const Q_15* src, BAM16 freq, int N)
 {
+  PROFILE_BEGIN(powerMeasurement_magnitude);
   Q16_15 sumI = 0;
   Q16_15 sumQ = 0;
   BAM16 angle=0;
   for( int j=0; j<N; ++j)
   {
     SINCOS16_t tmp=CORDIC16_sincos( angle );
-    sumI += ((Q16_15)tmp.cos * (Q16_15)(*src++))>>8;
-    sumQ -= ((Q16_15)tmp.sin * (Q16_15)(*src++))>>8;
+    Q16_15 x = *src++;
+    sumI += ((Q16_15)tmp.cos * x)>>8;
+    sumQ -= ((Q16_15)tmp.sin * x)>>8;
     angle+=freq;
   }
   sumI = (sumI + (1 << 6)) >> 7;
   sumQ = (sumQ + (1 << 6)) >> 7;
-  return sqrt(sumQ*sumQ + sumI*sumI);
+
+  // The squares would overflow 32 bits, so scale both into Q_15 for the
+  // CORDIC magnitude and scale that back. Under 2^14 leaves room for the
+  // sqrt(2) the magnitude can reach.
+  uint8_t shift = 0;
+  while( sumI >= (1L << 14) || sumI < -(1L << 14) || sumQ >= (1L << 14) || sumQ < -(1L << 14) )
+  {
+    sumI >>= 1;
+    sumQ >>= 1;
+    ++shift;
+  }
+  Complex16 v = { (Q_15)sumI, (Q_15)sumQ };
+  Q16_15 magnitude = (Q16_15)CORDIC16_rect2polar( v ).mag << shift;
+  PROFILE_END(powerMeasurement_magnitude);
+  return magnitude;
 }
 
 
+void Window_hann( Q_15* buf, int order )
+{
+  PROFILE_BEGIN(Window_hann);
+  const int N=1<<order;
+  BAM8 angle=0;
+  const BAM8 dAngle=(1<<(8-order));
+  for( int i=0; i<N; ++i)
+  {
+    // w = (1 - cos)/2
+    Q_15 w = (Q15_ONE - cosine_table(angle)) >> 1;
+    buf[i] = Q15_mult( buf[i], w );
+    angle+=dAngle;
+  }
+  PROFILE_END(Window_hann);
+}
+
 // Minimum = 0
 // Step = SAMPLE_RATE * 2^(-order)
 // Maximum = SAMPLE_RATE/2
 void FFT_inphase( Q_15* dst, const Q_15* src, int order , BAM8 phase)
 {
+  PROFILE_BEGIN(FFT_inphase);
   int N=1<<order;
   BAM8 dAngle=0;
   BAM8 ddAngle=(1<<(8-order));
@@ -287,11 +387,13 @@ void FFT_inphase( Q_15* dst, const Q_15* src, int order , BAM8 phase)
     *dst++ = ((sum + (1 << (6+order)))>> (7+order));
     dAngle+=ddAngle;
   }
+  PROFILE_END(FFT_inphase);
 }
 
 
 void FFT_magnitude( Q_15* dst, const Q_15* src, int order )
 {
+  PROFILE_BEGIN(FFT_magnitude);
   const int N=1<<order;
   Polar16 pol;
   Q_15 qData[N];
@@ -303,10 +405,12 @@ void FFT_magnitude( Q_15* dst, const Q_15* src, int order )
     pol=CORDIC16_rect2polar({dst[i],qData[i]});
     dst[i]=pol.mag;
   }
+  PROFILE_END(FFT_magnitude);
 }
 
 void IFT_magnitude( Q_15* dst, const Q_15* src, int order )
 {
+  PROFILE_BEGIN(IFT_magnitude);
   const int N=1<<order;
   Polar16 pol;
   Q_15 qData[N];
@@ -318,6 +422,178 @@ void IFT_magnitude( Q_15* dst, const Q_15* src, int order )
     pol=CORDIC16_rect2polar({dst[i],qData[i]});
     dst[i]=pol.mag;
   }
+  PROFILE_END(IFT_magnitude);
+}
+
+/**
+ * A radix 2 butterfly.
+ *
+ * @param shift 1 to halve the outputs, with rounding, 0 to leave them
+ */
+static inline void butterfly( Complex16* a, Complex16* b, Complex16 w, int shift )
+{
+  const int round = shift;
+  int32_t tr = Q15_mult( w.real, b->real ) - Q15_mult( w.imag, b->imag );
+  int32_t ti = Q15_mult( w.real, b->imag ) + Q15_mult( w.imag, b->real );
+  int32_t ar = a->real;
+  int32_t ai = a->imag;
+  a->real = Q15_sat( (ar + tr + round) >> shift );
+  a->imag = Q15_sat( (ai + ti + round) >> shift );
+  b->real = Q15_sat( (ar - tr + round) >> shift );
+  b->imag = Q15_sat( (ai - ti + round) >> shift );
+}
+
+void FPDSP_C(Complex16_butterfly)( Complex16* a, Complex16* b, Complex16 w )
+{
+  butterfly( a, b, w, 1 );
+}
+
+void FPDSP_C(Complex16_butterflyInverse)( Complex16* a, Complex16* b, Complex16 w )
+{
+  butterfly( a, b, w, 0 );
+}
+
+/**
+ * In place radix 2 decimation in time transform, the core of Complex_FFT and
+ * Complex_IFT. The forward transform halves every stage so it can't overflow.
+ * The inverse undoes that scaling, so it saturates instead.
+ *
+ * @param data the samples to transform in place
+ * @param order the order of magnitude of the transform. size = 2^order <= 256.
+ * @param inverse false for e^(-j) twiddles scaled by 1/N, true for e^(+j) unscaled
+ */
+static void radix2( Complex16* data, int order, bool inverse )
+{
+  const int N=1<<order;
+
+  // Reorder into bit reversed positions
+  for( int i=1, j=0; i<N; ++i)
+  {
+    int bit = N >> 1;
+    for( ; j & bit; bit >>= 1)
+    {
+      j ^= bit;
+    }
+    j ^= bit;
+    if( i < j )
+    {
+      Complex16 tmp = data[i];
+      data[i] = data[j];
+      data[j] = tmp;
+    }
+  }
+
+  // Butterflies, the twiddle for bin k of a size S stage is e^(-/+2*pi*k/S)
+  for( int stage=1; stage<=order; ++stage)
+  {
+    const int half = 1 << (stage - 1);
+    const BAM8 dAngle = 1 << (8 - stage);
+    BAM8 angle = 0;
+    for( int k=0; k<half; ++k)
+    {
+      Complex16 w = { cosine_table( angle ), cosine_table( angle - 64 ) }; // cos, sin
+      if( !inverse )
+      {
+        w.imag = -w.imag;
+      }
+      for( int i=k; i<N; i+=half<<1)
+      {
+        if( inverse )
+        {
+          Complex16_butterflyInverse( &data[i], &data[i + half], w );
+        }
+        else
+        {
+          Complex16_butterfly( &data[i], &data[i + half], w );
+        }
+      }
+      angle += dAngle;
+    }
+  }
+}
+
+void Complex_FFT( Complex16* dst, const Complex16* src, int order )
+{
+  PROFILE_BEGIN(Complex_FFT);
+  const int N=1<<order;
+  if( dst != src )
+  {
+    for( int i=0; i<N; ++i)
+    {
+      dst[i] = src[i];
+    }
+  }
+  radix2( dst, order, false );
+  PROFILE_END(Complex_FFT);
+}
+
+void Complex_IFT( Complex16* dst, const Complex16* src, int order )
+{
+  PROFILE_BEGIN(Complex_IFT);
+  const int N=1<<order;
+  if( dst != src )
+  {
+    for( int i=0; i<N; ++i)
+    {
+      dst[i] = src[i];
+    }
+  }
+  radix2( dst, order, true );
+  PROFILE_END(Complex_IFT);
+}
+
+void Real2Complex_FFT( Complex16* dst, const Q_15* src, int order )
+{
+  PROFILE_BEGIN(Real2Complex_FFT);
+  const int N=1<<order;
+  for( int i=0; i<N; ++i)
+  {
+    dst[i] = { *src++, 0 };
+  }
+  Complex_FFT( dst, dst, order );
+  PROFILE_END(Real2Complex_FFT);
+}
+
+void Complex2Real_IFT( Q_15* dst, Complex16* src, int order )
+{
+  PROFILE_BEGIN(Complex2Real_IFT);
+  const int N=1<<order;
+  radix2( src, order, true );
+  for( int i=0; i<N; ++i)
+  {
+    *dst++ = src[i].real;
+  }
+  PROFILE_END(Complex2Real_IFT);
+}
+
+void Biquad16_init( Biquad16* state )
+{
+  state->x1=0;
+  state->x2=0;
+  state->y1=0;
+  state->y2=0;
+}
+
+Q_15 Biquad16_step( Biquad16* state, const Biquad16Coeffs* coeffs, Q_15 x )
+{
+  PROFILE_BEGIN(Biquad16_step);
+  int32_t acc = (int32_t)coeffs->b0 * x
+              + (int32_t)coeffs->b1 * state->x1
+              + (int32_t)coeffs->b2 * state->x2
+              - (int32_t)coeffs->a1 * state->y1
+              - (int32_t)coeffs->a2 * state->y2;
+
+  // convert Q1_14 * Q_15 to Q_15, round and saturate
+  acc = (acc + (1 << 13)) >> 14;
+  acc = constrain(acc, -Q15_ONE, Q15_ONE);
+
+  state->x2 = state->x1;
+  state->x1 = x;
+  state->y2 = state->y1;
+  state->y1 = (Q_15)acc;
+
+  PROFILE_END(Biquad16_step);
+  return (Q_15)acc;
 }
 
 
@@ -22,6 +22,16 @@ extern "C" {
 #define Q15_ZERO 0x0000
 #define Q15_ONE  0x7FFF
 
+/**
+ * The hottest kernels have hand written AVR versions in DSP_avr.S. They are
+ * opt in: define FPDSP_USE_ASM for both C++ and assembly (the Arduino
+ * compiler.cpp.extra_flags and compiler.S.extra_flags) on a target with a
+ * hardware multiplier, then run examples/Benchmark to check them against the
+ * C versions.
+ */
+#if defined(__AVR__) && defined(__AVR_HAVE_MUL__) && defined(FPDSP_USE_ASM)
+#define FPDSP_AVR_ASM
+#endif
 
 /* Types *********************************************************************/
 
@@ -110,6 +120,12 @@ typedef uint16_t UQ_16;
  */
 typedef uint32_t UQ16_16;
 
+/**
+ *  Q1_14 is a 16 bit fixed point quantity representing numbers on the range [-2..2) at a step of 1/16384.
+ *  Used for filter coefficients which may exceed 1.
+ */
+typedef int16_t   Q1_14;
+
 typedef struct Q15_DIVMOD_t
 {
   Q16_15 quot;
@@ -143,6 +159,33 @@ typedef struct Polar16
   BAM16 phase;
 } Polar16;
 
+/**
+ * Coefficients of a second order IIR section, normalized so a0 = 1.
+ *
+ *  y[n] = b0*x[n] + b1*x[n-1] + b2*x[n-2] - a1*y[n-1] - a2*y[n-2]
+ *
+ * Kept separate from the state so one set can be shared by many filters.
+ */
+typedef struct Biquad16Coeffs
+{
+  Q1_14 b0;
+  Q1_14 b1;
+  Q1_14 b2;
+  Q1_14 a1;
+  Q1_14 a2;
+} Biquad16Coeffs;
+
+/**
+ * The state (delay line) of a second order IIR section in direct form I.
+ */
+typedef struct Biquad16
+{
+  Q_15 x1;
+  Q_15 x2;
+  Q_15 y1;
+  Q_15 y2;
+} Biquad16;
+
 /* Interfaces ****************************************************************/
 /* Data **********************************************************************/
 static const BAM16 BAM16_PI_RADIANS  = 0x8000;
@@ -311,6 +354,26 @@ static const BAM16 BAM16_30_DEGREES  = 0x8003/6;  //BAM16_90_DEGREES/3+0.5
  */
 Q16_15 Q15_MAC( Q_15* a, Q_15* b, int16_t count);
 
+/**
+ * Calculates the base 2 logarithm of an unsigned integer.
+ * Uses the bit by bit squaring method, so the result is exact to the last
+ * fractional bit.
+ *
+ * @param x the integer to take the logarithm of. 0 is treated as 1.
+ * @return log2(x) in Q16_15 on the range [0..32)
+ */
+Q16_15 fixed_log2( uint32_t x );
+
+/**
+ * Calculates the ratio of two powers in decibels, 10*log10(num/den).
+ * Zero powers are treated as 1 so the result is always finite.
+ *
+ * @param num the power in the numerator
+ * @param den the power in the denominator (reference)
+ * @return the ratio in dB as Q16_15
+ */
+Q16_15 power_ratio_dB( uint32_t num, uint32_t den );
+
 //int16_t add_sat ( int16_t a, int16_t b );
 //int16_t sub_sat ( int16_t a, int16_t b );
 //int32_t Q15_mult ( int32_t a, int32_t b );
@@ -328,6 +391,16 @@ Q16_15 Q15_MAC( Q_15* a, Q_15* b, int16_t count);
  */
 Q_15 cosine_table( BAM8 angle );
 
+/**
+ * Cosine of a BAM16 angle by linear interpolation between the entries of the
+ * 256 entry COSINE table. Much cheaper than CORDIC with an error of about
+ * 1/10000.
+ *
+ * @param angle the BAM16 angle to find the cosine of
+ * @return the cosine of angle stored as a Q_15 number
+ */
+Q_15 cosine_lerp( BAM16 angle );
+
 /**
  * Rotates vector by angle.
  * Uses a 16 bit version of the CORDIC algorithm.
@@ -381,16 +454,27 @@ Q16_15 powerMeasurement_inphase( const Q_15* src, BAM16 freq, BAM16 phase, int N
 
 /**
  * Performs a power measurement of the signal across phases with at a given
- * frequency
+ * frequency. The magnitude is taken with CORDIC16_rect2polar, so it doesn't
+ * overflow and keeps about 15 significant bits.
  *
  * @param src the signal under test
  * @param freq the frequency to analyze in BAM16 per SAMPLE
- * @param N the number of samples in src
- * @return the power measurement
+ * @param N the number of samples in src, at most 256
+ * @return the magnitude of the correlation, N/2 times the tone's amplitude
  */
 Q16_15 powerMeasurement_magnitude( const Q_15* src, BAM16 freq, int N);
 
 
+/**
+ * Applies a Hann window in place to a block of samples, to reduce the spectral
+ * leakage of tones that do not land exactly on a bin. A tone's power is spread
+ * over +/-2 bins around its center after windowing.
+ *
+ * @param buf the samples to window
+ * @param order the order of magnitude of the block. size = 2^order.
+ */
+void Window_hann( Q_15* buf, int order );
+
 /**
  * Performs a real mode Fourier Transform at a given single phase.
  *
@@ -412,20 +496,99 @@ void FFT_inphase( Q_15* dst, const Q_15* src, int order, BAM8 phase );
 void FFT_magnitude( Q_15* dst, const Q_15* src, int order );
 
 
-//void Complex_FFT( Complex16* dst, Complex16* src, int order );
-//void Complex_IFT( Complex16* dst, Complex16* src, int order );
+/**
+ * One radix 2 decimation in time butterfly of Complex_FFT,
+ * a, b = (a + w*b)/2, (a - w*b)/2, rounded and saturated.
+ *
+ * @param a the first input, replaced by the sum
+ * @param b the second input, replaced by the difference
+ * @param w the twiddle factor
+ */
+void Complex16_butterfly( Complex16* a, Complex16* b, Complex16 w );
 
-//void Real2Complex_FFT( Complex16* dst, Q_15* src, int order );
-//void Complex2Real_IFT( Q_15* dst, Complex16* src, int order );
+/**
+ * One radix 2 decimation in time butterfly of Complex_IFT,
+ * a, b = a + w*b, a - w*b, saturated.
+ *
+ * @param a the first input, replaced by the sum
+ * @param b the second input, replaced by the difference
+ * @param w the twiddle factor
+ */
+void Complex16_butterflyInverse( Complex16* a, Complex16* b, Complex16 w );
+
+/**
+ * Performs a radix 2 Fast Fourier Transform on complex data.
+ * Each stage is scaled by 1/2 to prevent overflow, so the result is scaled by
+ * 1/N the same as FFT_inphase.
+ *
+ * @param dst buffer to write the output of the transform, may be the same as src
+ * @param src the signal under test
+ * @param order the order of magnitude of the transform to perform. size = 2^order <= 256.
+ */
+void Complex_FFT( Complex16* dst, const Complex16* src, int order );
 
+/**
+ * Performs a radix 2 inverse Fast Fourier Transform on complex data.
+ * The result is not scaled, so it undoes Complex_FFT. Outputs saturate.
+ *
+ * @param dst buffer to write the output of the transform, may be the same as src
+ * @param src the spectrum to transform
+ * @param order the order of magnitude of the transform to perform. size = 2^order <= 256.
+ */
+void Complex_IFT( Complex16* dst, const Complex16* src, int order );
 
-// Filters
-// LPF
-// HPF
-// BPF
+/**
+ * Performs a Fast Fourier Transform on real data, keeping the phase.
+ * Bins above N/2 are the complex conjugates of those below.
+ *
+ * @param dst buffer to write the output of the transform
+ * @param src the signal under test
+ * @param order the order of magnitude of the transform to perform. size = 2^order <= 256.
+ */
+void Real2Complex_FFT( Complex16* dst, const Q_15* src, int order );
 
-// Define Filter
-// Apply Filter
+/**
+ * Performs an inverse Fast Fourier Transform to real data, undoing
+ * Real2Complex_FFT. The spectrum should be conjugate symmetric, any imaginary
+ * part left in the output is dropped.
+ *
+ * @param dst buffer to write the output of the transform
+ * @param src the spectrum to transform, used as working space and overwritten
+ * @param order the order of magnitude of the transform to perform. size = 2^order <= 256.
+ */
+void Complex2Real_IFT( Q_15* dst, Complex16* src, int order );
+
+
+#if defined(FPDSP_AVR_ASM)
+//*** C Reference Kernels *****************************************************
+
+// The C versions of the kernels in DSP_avr.S, to check them against.
+Q16_15 Q15_MAC_c( Q_15* a, Q_15* b, int16_t count);
+Complex16 CORDIC16_rotate_c( BAM16 angle, Complex16 vector );
+Polar16 CORDIC16_rect2polar_c( Complex16 vector );
+void Complex16_butterfly_c( Complex16* a, Complex16* b, Complex16 w );
+void Complex16_butterflyInverse_c( Complex16* a, Complex16* b, Complex16 w );
+#endif
+
+//*** Filters *****************************************************************
+
+/**
+ * Clears the state of a second order IIR section.
+ *
+ * @param state the filter state to clear
+ */
+void Biquad16_init( Biquad16* state );
+
+/**
+ * Runs one sample through a second order IIR section.
+ * The accumulator is 32 bits and the output is rounded and saturated.
+ *
+ * @param state the filter state
+ * @param coeffs the filter coefficients
+ * @param x the input sample
+ * @return the filtered output sample
+ */
+Q_15 Biquad16_step( Biquad16* state, const Biquad16Coeffs* coeffs, Q_15 x );
 
 
 
@@ -0,0 +1,154 @@
+/**
+ * @file    adpcm.cpp
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * IMA/DVI ADPCM codec, 4 bits per sample.
+ *
+ */
+
+/* Includes ******************************************************************/
+#include "adpcm.h"
+
+#include <Arduino.h>
+
+/* Defines *******************************************************************/
+#define ADPCM_STEPS 89
+
+/* Types *********************************************************************/
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+
+/**
+ *  IMA ADPCM quantizer step sizes, roughly 1.1^index.
+ */
+const PROGMEM uint16_t ADPCM_STEP_TABLE[ADPCM_STEPS] =
+{
+      7,     8,     9,    10,    11,    12,    13,    14,    16,    17,
+     19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+     50,    55,    60,    66,    73,    80,    88,    97,   107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+    337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+    876,   963,  1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+   2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+   5894,  6484,  7132,  7845,  8630,  9493, 10442, 11487, 12635, 13899,
+  15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+/**
+ *  Step table index adjustment for each code magnitude.
+ */
+static const int8_t ADPCM_INDEX_TABLE[8] =
+{
+  -1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+/* Functions *****************************************************************/
+
+void ADPCM_init( ADPCMState* state )
+{
+  state->predictor = 0;
+  state->index = 0;
+}
+
+/**
+ * Applies a code to the state, shared by the encoder and decoder so they
+ * reconstruct exactly the same samples.
+ */
+static Q_15 update( ADPCMState* state, uint8_t code, uint16_t step )
+{
+  // delta = (code + 1/2) * step / 4 by shifts and adds
+  int32_t delta = step >> 3;
+  if( code & 4 )
+  {
+    delta += step;
+  }
+  if( code & 2 )
+  {
+    delta += step >> 1;
+  }
+  if( code & 1 )
+  {
+    delta += step >> 2;
+  }
+
+  int32_t predictor = state->predictor;
+  predictor += (code & 8) ? -delta : delta;
+  state->predictor = constrain( predictor, -32768L, 32767L );
+
+  int8_t index = state->index + ADPCM_INDEX_TABLE[code & 7];
+  state->index = constrain( index, 0, ADPCM_STEPS - 1 );
+
+  return state->predictor;
+}
+
+uint8_t ADPCM_encodeSample( ADPCMState* state, Q_15 sample )
+{
+  uint16_t step = pgm_read_word( &ADPCM_STEP_TABLE[state->index] );
+  int32_t diff = (int32_t)sample - state->predictor;
+  uint8_t code = 0;
+
+  if( diff < 0 )
+  {
+    code = 8;
+    diff = -diff;
+  }
+
+  // Successive approximation of diff/step in 3 bits
+  uint16_t s = step;
+  if( diff >= s )
+  {
+    code |= 4;
+    diff -= s;
+  }
+  s >>= 1;
+  if( diff >= s )
+  {
+    code |= 2;
+    diff -= s;
+  }
+  s >>= 1;
+  if( diff >= s )
+  {
+    code |= 1;
+  }
+
+  update( state, code, step );
+  return code;
+}
+
+Q_15 ADPCM_decodeSample( ADPCMState* state, uint8_t code )
+{
+  uint16_t step = pgm_read_word( &ADPCM_STEP_TABLE[state->index] );
+  return update( state, code & 0x0F, step );
+}
+
+void ADPCM_encode( ADPCMState* state, uint8_t* dst, const Q_15* src, int count )
+{
+  while( count >= 2 )
+  {
+    uint8_t lo = ADPCM_encodeSample( state, *src++ );
+    uint8_t hi = ADPCM_encodeSample( state, *src++ );
+    *dst++ = lo | (hi << 4);
+    count -= 2;
+  }
+  if( count )
+  {
+    *dst = ADPCM_encodeSample( state, *src );
+  }
+}
+
+void ADPCM_decode( ADPCMState* state, Q_15* dst, const uint8_t* src, int count )
+{
+  while( count >= 2 )
+  {
+    uint8_t byte = *src++;
+    *dst++ = ADPCM_decodeSample( state, byte & 0x0F );
+    *dst++ = ADPCM_decodeSample( state, byte >> 4 );
+    count -= 2;
+  }
+  if( count )
+  {
+    *dst = ADPCM_decodeSample( state, *src & 0x0F );
+  }
+}
@@ -0,0 +1,81 @@
+/**
+ * @file    adpcm.h
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * IMA/DVI ADPCM codec, 4 bits per sample for 4:1 compression of Q_15 audio.
+ *
+ * Table driven with only shifts and adds, so it is cheap on parts without a
+ * multiplier. Samples are packed two per byte, the first in the low nibble,
+ * as in IMA ADPCM WAV files. The state must match between encoder and decoder,
+ * so store or send it with each independently decodable block.
+ *
+ */
+#ifndef   ADPCM_H
+#define   ADPCM_H
+
+/* Includes ******************************************************************/
+#include <inttypes.h>
+#include "DSP.h"
+
+/* Defines *******************************************************************/
+// Bytes needed to hold count encoded samples
+#define ADPCM_BYTES( count ) (((count) + 1) >> 1)
+
+/* Types *********************************************************************/
+typedef struct ADPCMState
+{
+  Q_15    predictor; ///< last reconstructed sample
+  uint8_t index;     ///< position in the step table
+} ADPCMState;
+
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+/**
+ * Initializes an ADPCMState
+ *
+ * @param state the ADPCMState to initialize
+ */
+void ADPCM_init( ADPCMState* state );
+
+/**
+ * Encodes one sample.
+ *
+ * @param state the encoder state
+ * @param sample the sample to encode
+ * @return the 4 bit code
+ */
+uint8_t ADPCM_encodeSample( ADPCMState* state, Q_15 sample );
+
+/**
+ * Decodes one sample.
+ *
+ * @param state the decoder state
+ * @param code the 4 bit code
+ * @return the reconstructed sample
+ */
+Q_15 ADPCM_decodeSample( ADPCMState* state, uint8_t code );
+
+/**
+ * Encodes a block of samples, two per byte.
+ *
+ * @param state the encoder state
+ * @param dst where to write ADPCM_BYTES(count) bytes
+ * @param src the samples to encode
+ * @param count the number of samples in src
+ */
+void ADPCM_encode( ADPCMState* state, uint8_t* dst, const Q_15* src, int count );
+
+/**
+ * Decodes a block of samples, two per byte.
+ *
+ * @param state the decoder state
+ * @param dst where to write count samples
+ * @param src the ADPCM_BYTES(count) encoded bytes
+ * @param count the number of samples to decode
+ */
+void ADPCM_decode( ADPCMState* state, Q_15* dst, const uint8_t* src, int count );
+
+#endif // ADPCM_H
@@ -0,0 +1,253 @@
+/**
+ * @file    cw.cpp
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Streaming CW (Morse code) decoder for receiver audio.
+ *
+ */
+
+/* Includes ******************************************************************/
+#include "cw.h"
+
+#include <Arduino.h>
+
+/* Defines *******************************************************************/
+// Samples are scaled down to 10 bits so a full block can't overflow
+#define CW_INPUT_SHIFT 6
+
+// Key down must be at least 9dB (3 in log2) over key up to count
+#define CW_MIN_CONTRAST (3L << 15)
+
+// Levels average over 2^CW_AVERAGE_SHIFT blocks, and with no signal the key
+// down level sinks toward key up over 2^CW_DECAY_SHIFT blocks
+#define CW_AVERAGE_SHIFT 3
+#define CW_DECAY_SHIFT   9
+
+// Shortest dit followed, 2 blocks in UQ8_8
+#define CW_MIN_DIT 0x200
+
+// Longest code in CW_TABLE
+#define CW_MAX_ELEMENTS 6
+
+/* Types *********************************************************************/
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+
+/**
+ *  Morse code as a binary tree. Starting at index 1 each dit goes to 2*i and
+ *  each dah to 2*i+1, so the index of a code is its elements in binary after
+ *  a leading 1.
+ */
+const PROGMEM char CW_TABLE[1 << (CW_MAX_ELEMENTS + 1)] =
+{
+    0,   0, 'E', 'T', 'I', 'A', 'N', 'M', 'S', 'U', 'R', 'W', 'D', 'K', 'G', 'O',
+  'H', 'V', 'F',   0, 'L',   0, 'P', 'J', 'B', 'X', 'C', 'Y', 'Z', 'Q',   0,   0,
+  '5', '4',   0, '3',   0,   0,   0, '2',   0,   0, '+',   0,   0,   0,   0, '1',
+  '6', '=', '/',   0,   0,   0, '(',   0, '7',   0,   0,   0, '8',   0, '9', '0',
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0, '?',   0,   0,   0,
+    0,   0, '"',   0,   0, '.',   0,   0,   0,   0, '@',   0,   0,   0, '\'',  0,
+    0, '-',   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0, ')',   0,   0,
+    0,   0,   0, ',',   0,   0,   0,   0, ':',   0,   0,   0,   0,   0,   0,   0,
+};
+
+/* Functions *****************************************************************/
+
+void CW_init( CWDecoder* cw, BAM16 tone, uint8_t blockSize, uint16_t ditQ8 )
+{
+  cw->s1 = 0;
+  cw->s2 = 0;
+  cw->end1 = 0;
+  cw->end2 = 0;
+  cw->ready = false;
+  // 2*cos(w) in Q1_14 has the same bits as cos(w) in Q_15
+  cw->coeff = cosine_lerp( tone );
+  cw->blockSize = constrain( blockSize, 1, CW_MAX_BLOCK );
+  cw->count = 0;
+  cw->high = 0;
+  cw->low = 0;
+  cw->run = 0;
+  cw->dit = ditQ8;
+  cw->code = 1;
+  cw->key = false;
+  cw->spaced = true;
+}
+
+/**
+ * Looks up and clears the pending code.
+ */
+static char emit( CWDecoder* cw )
+{
+  char c = '*';
+  if( cw->code < (1 << (CW_MAX_ELEMENTS + 1)) )
+  {
+    c = pgm_read_byte( &CW_TABLE[cw->code] );
+    if( !c )
+    {
+      c = '*';
+    }
+  }
+  cw->code = 1;
+  return c;
+}
+
+/**
+ * Runs once per block with the tone level, returning any decoded character.
+ */
+static char block( CWDecoder* cw, Q16_15 level )
+{
+  char out = 0;
+
+  // Average the level into key down while keyed and into key up when below
+  // the threshold. Peaks lift the key down level at once, and through long
+  // gaps it sinks toward key up so a fading signal is still followed.
+  Q16_15 contrast = cw->high - cw->low;
+  Q16_15 mid = cw->low + (contrast >> 1);
+  if( contrast <= CW_MIN_CONTRAST )
+  {
+    // No threshold yet. A clearly higher level starts what may be the first
+    // element, and a clear drop below it shows that it was one, so it is
+    // counted rather than lost while the levels settle.
+    if( level > cw->high + CW_MIN_CONTRAST )
+    {
+      cw->run = 0;
+    }
+    else if( level < cw->high - CW_MIN_CONTRAST )
+    {
+      cw->low = level;
+      cw->key = true;
+    }
+  }
+  if( level > cw->high )
+  {
+    cw->high = level;
+  }
+  else if( cw->key )
+  {
+    cw->high += (level - cw->high) >> CW_AVERAGE_SHIFT;
+  }
+  else if( level < mid )
+  {
+    cw->low += (level - cw->low) >> CW_AVERAGE_SHIFT;
+    if( contrast > CW_MIN_CONTRAST * 2 )
+    {
+      cw->high -= contrast >> CW_DECAY_SHIFT;
+    }
+  }
+
+  // Threshold halfway between in log, with hysteresis of 1/8th the contrast
+  contrast = cw->high - cw->low;
+  mid = cw->low + (contrast >> 1);
+  Q16_15 hysteresis = cw->key ? -(contrast >> 3) : (contrast >> 3);
+  bool key = (contrast > CW_MIN_CONTRAST) && (level > mid + hysteresis);
+
+  if( key != cw->key )
+  {
+    uint16_t length = cw->run << 8; // UQ8_8 blocks
+    if( cw->key && length < (cw->dit >> 2) )
+    {
+      // Too short to be an element, ignore it as a noise spike
+    }
+    else if( cw->key )
+    {
+      // Element ended, a dah is 3 dits so split at 2 and refine the dit length
+      bool dah = length >= (cw->dit << 1);
+      if( dah )
+      {
+        cw->dit += ((int32_t)(length / 3) - cw->dit) >> 2;
+      }
+      else
+      {
+        cw->dit += ((int32_t)length - cw->dit) >> 2;
+      }
+      cw->dit = max( cw->dit, (uint16_t)CW_MIN_DIT );
+      // Codes too long for the table stick above it until emitted, tested
+      // before shifting so they can't wrap
+      if( cw->code < (1 << (CW_MAX_ELEMENTS + 1)) )
+      {
+        cw->code = (cw->code << 1) | dah;
+      }
+    }
+    cw->key = key;
+    cw->run = 0;
+  }
+
+  if( cw->run < 0xFF )
+  {
+    ++cw->run;
+  }
+
+  if( !cw->key )
+  {
+    uint16_t length = cw->run << 8;
+    // Letters end after 2 dits of silence (nominally 3), words after 5 (7)
+    if( cw->code > 1 && length >= (cw->dit << 1) )
+    {
+      out = emit( cw );
+      cw->spaced = false;
+    }
+    else if( !cw->spaced && length >= (uint32_t)cw->dit * 5 )
+    {
+      out = ' ';
+      cw->spaced = true;
+    }
+  }
+
+  return out;
+}
+
+bool CW_push( CWDecoder* cw, Q_15 sample )
+{
+  // Goertzel resonator: s = x + 2cos(w)*s1 - s2
+  int32_t s = (sample >> CW_INPUT_SHIFT) + (((int32_t)cw->coeff * cw->s1) >> 14) - cw->s2;
+  cw->s2 = cw->s1;
+  cw->s1 = s;
+
+  if( ++cw->count < cw->blockSize )
+  {
+    return false;
+  }
+
+  // Hand the block to CW_decode, the energy and log are too slow for an ISR
+  cw->end1 = cw->s1;
+  cw->end2 = cw->s2;
+  cw->ready = true;
+  cw->s1 = 0;
+  cw->s2 = 0;
+  cw->count = 0;
+  return true;
+}
+
+char CW_decode( CWDecoder* cw )
+{
+  noInterrupts();
+  bool ready = cw->ready;
+  int32_t s1 = cw->end1;
+  int32_t s2 = cw->end2;
+  cw->ready = false;
+  interrupts();
+  if( !ready )
+  {
+    return 0;
+  }
+
+  // |X|^2 = s1^2 + s2^2 - 2cos(w)*s1*s2
+  int64_t power = (int64_t)s1 * s1 + (int64_t)s2 * s2
+                - (((int64_t)cw->coeff * s1) >> 14) * s2;
+
+  uint32_t p = (power > 0xFFFFFFFFLL) ? 0xFFFFFFFFUL : (uint32_t)max( power, (int64_t)0 );
+  Q16_15 level = fixed_log2( p );
+  if( 0 == cw->high )
+  {
+    // Start both levels from the first block that has any signal
+    cw->high = level;
+    cw->low = level;
+    cw->run = 0;
+  }
+  return block( cw, level );
+}
+
+uint16_t CW_ditLength( CWDecoder* cw )
+{
+  return cw->dit;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file    cw.h
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Streaming CW (Morse code) decoder for receiver audio.
+ *
+ * A Goertzel single bin detector on the keyed tone costs one multiply per
+ * sample, and is all CW_push does, so it can run in the ADC ISR. Everything
+ * else runs once per block in CW_decode, from the main loop: the tone level is
+ * compared, in the log domain, against a threshold halfway between tracked
+ * key down and key up levels, and element and gap lengths are classified
+ * against an adaptive dit length, so the decoder follows the sender's speed.
+ * The Benchmark example reports the cost of both on the target.
+ *
+ *     ISR (ADC_vect)
+ *     {
+ *       CW_push( &cw, ADC_readCurrentSample() );
+ *     }
+ *
+ *     void loop()
+ *     {
+ *       char c = CW_decode( &cw );
+ *       if( c ) Serial.print( c );
+ *     }
+ *
+ */
+#ifndef   CW_H
+#define   CW_H
+
+/* Includes ******************************************************************/
+#include <inttypes.h>
+#include "DSP.h"
+
+/* Defines *******************************************************************/
+// Largest block that keeps the Goertzel state inside 32 bits
+#define CW_MAX_BLOCK 64
+
+/**
+ * Converts a sending speed to the dit length CW_init expects.
+ * PARIS timing: a dit is 1200/WPM ms.
+ *
+ * @param WPM sending speed in words per minute
+ * @param SAMPLE_RATE the sample rate in Hz
+ * @param BLOCK the detector block size in samples
+ * @return the dit length in blocks as UQ8_8
+ */
+#define CW_DIT_BLOCKS_Q8( WPM, SAMPLE_RATE, BLOCK ) ((uint16_t)((1200UL * 256 * (SAMPLE_RATE)) / (1000UL * (WPM) * (BLOCK))))
+
+/* Types *********************************************************************/
+typedef struct CWDecoder
+{
+  int32_t  s1;          ///< Goertzel state
+  int32_t  s2;
+  int32_t  end1;        ///< Goertzel state at the end of the last block
+  int32_t  end2;
+  volatile bool ready;  ///< end1 and end2 are waiting for CW_decode
+  Q1_14    coeff;       ///< 2*cos(tone)
+  uint8_t  blockSize;
+  uint8_t  count;       ///< samples into the current block
+  Q16_15   high;        ///< key down level, log2
+  Q16_15   low;         ///< key up level, log2
+  uint16_t run;         ///< blocks in the current key state
+  uint16_t dit;         ///< dit length in blocks, UQ8_8
+  uint8_t  code;        ///< elements received, 1 marks the start
+  bool     key;
+  bool     spaced;      ///< word space already sent
+} CWDecoder;
+
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+/**
+ * Initializes a CWDecoder
+ *
+ * @param cw the CWDecoder to initialize
+ * @param tone the keyed tone frequency in BAM16 per sample
+ * @param blockSize samples per detector block, at most CW_MAX_BLOCK. ~4ms works well.
+ * @param ditQ8 starting dit length from CW_DIT_BLOCKS_Q8
+ */
+void CW_init( CWDecoder* cw, BAM16 tone, uint8_t blockSize, uint16_t ditQ8 );
+
+/**
+ * Adds one sample to the tone detector. Safe to call from an ISR.
+ *
+ * @param cw the CWDecoder
+ * @param sample the next sample
+ * @return true when a block is complete and waiting for CW_decode
+ */
+bool CW_push( CWDecoder* cw, Q_15 sample );
+
+/**
+ * Decodes the last completed block, if any. Call it at least once per block
+ * from the main loop. If a block is missed the newer one replaces it.
+ *
+ * @param cw the CWDecoder
+ * @return a decoded character, ' ' between words, '*' for an unknown code or 0
+ */
+char CW_decode( CWDecoder* cw );
+
+/**
+ * Returns the current estimate of the sending speed.
+ *
+ * @param cw the CWDecoder
+ * @return the dit length in blocks as UQ8_8
+ */
+uint16_t CW_ditLength( CWDecoder* cw );
+
+#endif // CW_H
@@ -0,0 +1,115 @@
+/**
+ * @file    denoise.cpp
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Streaming spectral subtraction noise reduction.
+ *
+ */
+
+/* Includes ******************************************************************/
+#include "denoise.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+/* Defines *******************************************************************/
+// A bin more than this many times the noise estimate holds signal
+#define DENOISE_PRESENCE_RATIO 3
+
+// Noise estimate averages over 2^AVERAGE frames, and creeps toward signal
+// over 2^RISE frames so a raised noise floor is eventually learned.
+#define DENOISE_AVERAGE_SHIFT 3
+#define DENOISE_RISE_SHIFT    9
+
+/* Types *********************************************************************/
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+void Denoiser_init( Denoiser* dn, int order, uint8_t oversubQ4, Q_15 floor )
+{
+  memset( dn, 0, sizeof(*dn) );
+  dn->order = constrain( order, 2, DENOISE_MAX_ORDER );
+  dn->oversub = oversubQ4;
+  dn->floor = floor;
+}
+
+/**
+ * Updates the noise estimate for a bin and returns the gain to apply to it.
+ */
+static Q_15 binGain( Denoiser* dn, int k, Q_15 mag )
+{
+  Q_15* noise = &dn->noise[k];
+
+  if( dn->frames < DENOISE_LEARN_FRAMES )
+  {
+    // Running average while learning
+    *noise += (mag - *noise) / (dn->frames + 1);
+    return Q15_ONE;
+  }
+
+  // Average the bin while it looks like noise, only creep up on anything well
+  // above the estimate so tones and speech don't get learned as noise.
+  int32_t diff = (int32_t)mag - *noise;
+  if( mag <= (int32_t)*noise * DENOISE_PRESENCE_RATIO + 1 )
+  {
+    *noise += diff >> DENOISE_AVERAGE_SHIFT;
+  }
+  else
+  {
+    *noise += 1 + (diff >> DENOISE_RISE_SHIFT);
+  }
+
+  int32_t sub = ((int32_t)*noise * dn->oversub) >> 4;
+  if( sub >= mag )
+  {
+    return dn->floor;
+  }
+  // sub can be 0, and a gain of 1 would wrap to -1 in Q_15
+  int32_t gain = min( (((int32_t)mag - sub) << 15) / mag, (int32_t)Q15_ONE );
+  return max( (Q_15)gain, dn->floor );
+}
+
+void Denoiser_process( Denoiser* dn, Q_15* out, const Q_15* in )
+{
+  const int N=1<<dn->order;
+  const int hop=N>>1;
+  Q_15 frame[N];
+  Complex16 spectrum[N];
+
+  memcpy( frame, dn->history, hop * sizeof(Q_15) );
+  memcpy( frame + hop, in, hop * sizeof(Q_15) );
+  memcpy( dn->history, in, hop * sizeof(Q_15) );
+
+  Window_hann( frame, dn->order );
+  Real2Complex_FFT( spectrum, frame, dn->order );
+
+  // Scale each bin and its conjugate mirror by the same real gain, which
+  // leaves the phase alone.
+  for( int k=0; k<=hop; ++k)
+  {
+    Q_15 mag = CORDIC16_rect2polar( spectrum[k] ).mag;
+    Q_15 gain = binGain( dn, k, mag );
+    spectrum[k].real = Q15_mult( spectrum[k].real, gain );
+    spectrum[k].imag = Q15_mult( spectrum[k].imag, gain );
+    if( k > 0 && k < hop )
+    {
+      spectrum[N - k].real = spectrum[k].real;
+      spectrum[N - k].imag = -spectrum[k].imag;
+    }
+  }
+  if( dn->frames < DENOISE_LEARN_FRAMES )
+  {
+    ++dn->frames;
+  }
+
+  Complex2Real_IFT( frame, spectrum, dn->order );
+
+  for( int i=0; i<hop; ++i)
+  {
+    int32_t sum = (int32_t)dn->overlap[i] + frame[i];
+    out[i] = Q15_sat( sum );
+    dn->overlap[i] = frame[hop + i];
+  }
+}
@@ -0,0 +1,74 @@
+/**
+ * @file    denoise.h
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Streaming spectral subtraction noise reduction.
+ *
+ * Frames of 2^order samples overlap by half. Each is Hann windowed and
+ * transformed, every bin is scaled by a gain that subtracts the tracked noise
+ * magnitude (keeping the bin's phase), and the inverse transforms are
+ * overlap-added. The periodic Hann window sums to 1 at 50% overlap so no
+ * synthesis window is needed. Output lags input by half a frame.
+ *
+ *     Denoiser dn;
+ *     Denoiser_init( &dn, 7, 32, Q15_ONE/8 );
+ *     while( SampleBuffer_popAllOrNothing( &sb, hop, 64 ) )
+ *     {
+ *       Denoiser_process( &dn, hop, hop );
+ *       store( hop, 64 );
+ *     }
+ *
+ */
+#ifndef   DENOISE_H
+#define   DENOISE_H
+
+/* Includes ******************************************************************/
+#include <inttypes.h>
+#include "DSP.h"
+
+/* Defines *******************************************************************/
+// FIXED SIZE allows for a lot of optimizations vs parameterized size.
+#define DENOISE_MAX_ORDER 8
+#define DENOISE_MAX_HOP   (1 << (DENOISE_MAX_ORDER - 1))
+
+// Frames averaged to seed the noise estimate before any subtraction
+#define DENOISE_LEARN_FRAMES 8
+
+/* Types *********************************************************************/
+typedef struct Denoiser
+{
+  Q_15     history[DENOISE_MAX_HOP];    ///< previous hop of input
+  Q_15     overlap[DENOISE_MAX_HOP];    ///< second half of the previous output frame
+  Q_15     noise[DENOISE_MAX_HOP + 1];  ///< noise magnitude per bin
+  Q_15     floor;                       ///< lowest gain applied to a bin
+  uint8_t  order;
+  uint8_t  oversub;                     ///< noise over subtraction, UQ4_4
+  uint8_t  frames;                      ///< frames seen while learning
+} Denoiser;
+
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+/**
+ * Initializes a Denoiser. The first DENOISE_LEARN_FRAMES frames are assumed to
+ * be mostly noise and pass through untouched while the estimate settles.
+ *
+ * @param dn the Denoiser to initialize
+ * @param order the order of magnitude of the frames, at most DENOISE_MAX_ORDER. size = 2^order.
+ * @param oversubQ4 multiple of the noise magnitude to subtract in 1/16ths, 16 is 1.0
+ * @param floor the lowest gain for a bin, limits musical noise
+ */
+void Denoiser_init( Denoiser* dn, int order, uint8_t oversubQ4, Q_15 floor );
+
+/**
+ * Denoises one hop (half a frame) of samples.
+ *
+ * @param dn the Denoiser
+ * @param out where to write 2^(order-1) denoised samples, may be the same as in
+ * @param in the next 2^(order-1) input samples
+ */
+void Denoiser_process( Denoiser* dn, Q_15* out, const Q_15* in );
+
+#endif // DENOISE_H
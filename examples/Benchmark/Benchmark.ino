@@ -0,0 +1,478 @@
+/**
+ * @file    Benchmark.ino
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Times the fpDSP kernels on the target and prints the results to Serial.
+ *
+ * Timer 1 is run from the undivided CPU clock so every count is one cycle.
+ * While a kernel is timed Serial has drained and the millis() Timer 0
+ * interrupt is masked, so the only other code counted is the Timer 1
+ * overflow ISR, a few dozen cycles every 65536.
+ * Results are the average of BENCH_REPEATS calls, given per call and per
+ * sample processed, with the share of an 8kHz sample period (PERIOD_US_8KHZ)
+ * that the per sample cost takes.
+ *
+ * When the AVR assembly kernels are built (FPDSP_USE_ASM, see DSP.h) they are
+ * first checked against the C versions over random inputs, and both are
+ * timed.
+ *
+ * RAM is budgeted for an Uno: about 830 bytes of buffers, the kernel names
+ * kept in flash with F(), and under 400 bytes of stack in FFT_magnitude or
+ * LPC_levinson, leaving some 400 of the 2K free with Serial.
+ *
+ * Runs the same on a board or in simavr, where the counts are repeatable. Build
+ * with BENCH_HALT defined to stop the simulator when done, see
+ * extras/simavr/benchmark.sh.
+ *
+ */
+
+/* Includes ******************************************************************/
+#include <DSP.h>
+#include <cw.h>
+#include <lpc.h>
+#include <psk.h>
+#include <samples.h>
+
+#if defined(BENCH_HALT)
+#include <avr/sleep.h>
+#endif
+
+/* Defines *******************************************************************/
+#define BENCH_REPEATS 4
+
+// 20ms telephone band speech frame at 8kHz
+#define LPC_FRAME 160
+
+// PSK31 at 8kHz
+#define PSK_SAMPLES_PER_SYMBOL 256
+#define PSK_SYMBOLS 8
+
+// CW at 20 WPM and 8kHz in 4ms blocks, long enough for a dit, a dah and the
+// letter they make
+#define CW_BLOCK 32
+#define CW_DIT_BLOCKS 15
+#define CW_BLOCKS (8 * CW_DIT_BLOCKS + 10)
+
+// Largest transform timed, bounded by RAM on an ATmega328P
+#define FFT_MAX_ORDER 7
+
+// Random inputs the assembly kernels are checked with
+#define VERIFY_CASES 1000
+
+// CPU cycles in one 8kHz sample period
+#define SAMPLE_PERIOD_CYCLES ((uint32_t)PERIOD_US_8KHZ * (F_CPU / 1000000L))
+
+/* Types *********************************************************************/
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+static Q_15 frame[LPC_FRAME];
+static volatile uint16_t timerOverflows;
+static uint8_t timer0Mask;   // TIMSK0 while no kernel is timed
+
+// Transform output, shared as the kernels are timed one at a time
+static union
+{
+  Q_15      real[1 << FFT_MAX_ORDER];
+  Complex16 complex[1 << FFT_MAX_ORDER];
+} scratch;
+
+/* Functions *****************************************************************/
+
+ISR(TIMER1_OVF_vect)
+{
+  ++timerOverflows;
+}
+
+/**
+ * Restarts the cycle counter, after the last report has been sent and with
+ * the Timer 0 interrupt masked until cyclesRead
+ */
+static void cyclesStart( void )
+{
+  Serial.flush();
+  noInterrupts();
+  timer0Mask = TIMSK0;
+  TIMSK0 = 0;
+  TCCR1A = 0;
+  TCCR1B = 0;
+  TCNT1 = 0;
+  timerOverflows = 0;
+  TIFR1 = bit (TOV1);
+  TIMSK1 = bit (TOIE1);
+  TCCR1B = bit (CS10);  // no prescaler, 1 tick per cycle
+  interrupts();
+}
+
+/**
+ * Reads the cycle counter and unmasks the Timer 0 interrupt again
+ *
+ * @return cycles since cyclesStart
+ */
+static uint32_t cyclesRead( void )
+{
+  noInterrupts();
+  uint16_t ticks = TCNT1;
+  uint32_t overflows = timerOverflows;
+  if( (TIFR1 & bit (TOV1)) && ticks < 0x8000 )
+  {
+    ++overflows;
+  }
+  TIMSK0 = timer0Mask;
+  interrupts();
+  return (overflows << 16) | ticks;
+}
+
+/**
+ * Prints the average cost of a kernel.
+ *
+ * @param name the kernel
+ * @param param its size or order
+ * @param cycles total for BENCH_REPEATS calls
+ * @param samples samples processed per call
+ */
+static void report( const __FlashStringHelper* name, int param, uint32_t cycles, int samples )
+{
+  uint32_t perCall = cycles / BENCH_REPEATS;
+  uint32_t perSample = perCall / samples;
+
+  Serial.print( name );
+  Serial.print( F(" ") );
+  Serial.print( param );
+  Serial.print( F(": ") );
+  Serial.print( perCall );
+  Serial.print( F(" cycles, ") );
+  Serial.print( perSample );
+  Serial.print( F(" per sample, ") );
+  Serial.print( (perSample * 100 + SAMPLE_PERIOD_CYCLES / 2) / SAMPLE_PERIOD_CYCLES );
+  Serial.println( F("% of 8kHz") );
+}
+
+#if defined(FPDSP_AVR_ASM)
+/**
+ * Prints a mismatch between an assembly kernel and its C version.
+ *
+ * @param name the kernel
+ * @param asmResult its result
+ * @param cResult the result of the C version
+ */
+static void mismatch( const __FlashStringHelper* name, int32_t asmResult, int32_t cResult )
+{
+  Serial.print( F("MISMATCH ") );
+  Serial.print( name );
+  Serial.print( F(": ") );
+  Serial.print( asmResult );
+  Serial.print( F(" != ") );
+  Serial.println( cResult );
+}
+
+static Q_15 randomQ15( void )
+{
+  return (Q_15)random( -32768L, 32768L );
+}
+
+/**
+ * Checks the kernels in DSP_avr.S give exactly the same results as the C
+ * versions.
+ *
+ * @return the number of mismatches
+ */
+static uint16_t verifyASM( void )
+{
+  uint16_t errors = 0;
+
+  for( int i=0; i<VERIFY_CASES; ++i)
+  {
+    BAM16 angle = (BAM16)random( 0x10000L );
+    Complex16 v = { randomQ15(), randomQ15() };
+
+    Complex16 r = CORDIC16_rotate( angle, v );
+    Complex16 rc = CORDIC16_rotate_c( angle, v );
+    if( r.x != rc.x || r.y != rc.y )
+    {
+      mismatch( F("CORDIC16_rotate"), ((int32_t)r.x << 16) | (uint16_t)r.y, ((int32_t)rc.x << 16) | (uint16_t)rc.y );
+      ++errors;
+    }
+
+    Polar16 p = CORDIC16_rect2polar( v );
+    Polar16 pc = CORDIC16_rect2polar_c( v );
+    if( p.mag != pc.mag || p.phase != pc.phase )
+    {
+      mismatch( F("CORDIC16_rect2polar"), ((int32_t)p.mag << 16) | p.phase, ((int32_t)pc.mag << 16) | pc.phase );
+      ++errors;
+    }
+
+    // Twiddles as radix2 makes them for half the cases, any w for the rest,
+    // with -32768 forced in as -32768 * -32768 is the one product over 1
+    BAM8 t = (BAM8)random( 0x100 );
+    Complex16 w = { cosine_table( t ), cosine_table( t - 64 ) };
+    if( i & 2 )
+    {
+      w.real = randomQ15();
+      w.imag = randomQ15();
+    }
+    Complex16 a = { randomQ15(), randomQ15() };
+    Complex16 b = { randomQ15(), randomQ15() };
+    if( 0 == (i & 12) )
+    {
+      w.real = -32768;
+      b.imag = -32768;
+    }
+    else if( 4 == (i & 12) )
+    {
+      w.imag = -32768;
+      b.real = -32768;
+    }
+    Complex16 ac = a;
+    Complex16 bc = b;
+    if( i & 1 )
+    {
+      Complex16_butterfly( &a, &b, w );
+      Complex16_butterfly_c( &ac, &bc, w );
+    }
+    else
+    {
+      Complex16_butterflyInverse( &a, &b, w );
+      Complex16_butterflyInverse_c( &ac, &bc, w );
+    }
+    if( a.real != ac.real || a.imag != ac.imag || b.real != bc.real || b.imag != bc.imag )
+    {
+      mismatch( F("Complex16_butterfly"), i, 0 );
+      ++errors;
+    }
+  }
+
+  for( int count=0; count<=(1 << FFT_MAX_ORDER); count+=16)
+  {
+    for( int i=0; i<count; ++i)
+    {
+      scratch.real[i] = randomQ15();
+    }
+    Q16_15 m = Q15_MAC( frame, scratch.real, count );
+    Q16_15 mc = Q15_MAC_c( frame, scratch.real, count );
+    if( m != mc )
+    {
+      mismatch( F("Q15_MAC"), m, mc );
+      ++errors;
+    }
+  }
+
+  Serial.print( F("verifyASM: ") );
+  Serial.print( errors );
+  Serial.println( F(" mismatches") );
+  return errors;
+}
+#endif
+
+static void benchCORDIC( void )
+{
+  Complex16 v = { Q15_ONE >> 1, 0 };
+  BAM16 angle = 0x1234;
+
+  cyclesStart();
+  for( int i=0; i<BENCH_REPEATS; ++i)
+  {
+    v = CORDIC16_rotate( angle, v );
+  }
+  report( F("CORDIC16_rotate"), 16, cyclesRead(), 1 );
+
+  cyclesStart();
+  for( int i=0; i<BENCH_REPEATS; ++i)
+  {
+    volatile Polar16 p = CORDIC16_rect2polar( v );
+    (void)p;
+  }
+  report( F("CORDIC16_rect2polar"), 16, cyclesRead(), 1 );
+
+#if defined(FPDSP_AVR_ASM)
+  cyclesStart();
+  for( int i=0; i<BENCH_REPEATS; ++i)
+  {
+    v = CORDIC16_rotate_c( angle, v );
+  }
+  report( F("CORDIC16_rotate_c"), 16, cyclesRead(), 1 );
+
+  cyclesStart();
+  for( int i=0; i<BENCH_REPEATS; ++i)
+  {
+    volatile Polar16 p = CORDIC16_rect2polar_c( v );
+    (void)p;
+  }
+  report( F("CORDIC16_rect2polar_c"), 16, cyclesRead(), 1 );
+#endif
+}
+
+static void benchMAC( void )
+{
+  for( int count=16; count<=LPC_FRAME; count<<=1)
+  {
+    volatile Q16_15 total;
+    cyclesStart();
+    for( int i=0; i<BENCH_REPEATS; ++i)
+    {
+      total = Q15_MAC( frame, frame, count );
+    }
+    report( F("Q15_MAC"), count, cyclesRead(), count );
+
+#if defined(FPDSP_AVR_ASM)
+    cyclesStart();
+    for( int i=0; i<BENCH_REPEATS; ++i)
+    {
+      total = Q15_MAC_c( frame, frame, count );
+    }
+    report( F("Q15_MAC_c"), count, cyclesRead(), count );
+#endif
+    (void)total;
+  }
+}
+
+static void benchFFT( void )
+{
+  for( int order=4; order<=FFT_MAX_ORDER; ++order)
+  {
+    const int N = 1 << order;
+
+    cyclesStart();
+    for( int i=0; i<BENCH_REPEATS; ++i)
+    {
+      FFT_inphase( scratch.real, frame, order, 0 );
+    }
+    report( F("FFT_inphase"), order, cyclesRead(), N );
+
+    cyclesStart();
+    for( int i=0; i<BENCH_REPEATS; ++i)
+    {
+      FFT_magnitude( scratch.real, frame, order );
+    }
+    report( F("FFT_magnitude"), order, cyclesRead(), N );
+
+    cyclesStart();
+    for( int i=0; i<BENCH_REPEATS; ++i)
+    {
+      Real2Complex_FFT( scratch.complex, frame, order );
+    }
+    report( F("Real2Complex_FFT"), order, cyclesRead(), N );
+  }
+}
+
+static void benchLPC( void )
+{
+  int32_t r[LPC_MAX_ORDER + 1];
+  Q3_12 a[LPC_MAX_ORDER + 1];
+  Q_15 k[LPC_MAX_ORDER];
+
+  for( int order=8; order<=LPC_MAX_ORDER; ++order)
+  {
+    cyclesStart();
+    for( int i=0; i<BENCH_REPEATS; ++i)
+    {
+      LPC_autocorrelation( r, frame, LPC_FRAME, order );
+    }
+    report( F("LPC_autocorrelation"), order, cyclesRead(), LPC_FRAME );
+
+    cyclesStart();
+    for( int i=0; i<BENCH_REPEATS; ++i)
+    {
+      LPC_levinson( a, k, r, order );
+    }
+    report( F("LPC_levinson"), order, cyclesRead(), LPC_FRAME );
+  }
+}
+
+static void benchPSK( void )
+{
+  PSKDemod psk;
+  Complex16 symbol;
+  uint8_t bits;
+  BAM16 carrier = FREQUENCY_HZtoBAM16_PER_SAMPLE( 1000, 8000 );
+  BAM16 angle = 0;
+
+  PSKDemod_init( &psk, carrier, PSK_SAMPLES_PER_SYMBOL, PSK_DBPSK );
+  cyclesStart();
+  for( int s=0; s<PSK_SYMBOLS; ++s)
+  {
+    // Alternating reversals, the PSK31 idle
+    angle += BAM16_180_DEGREES;
+    for( int i=0; i<PSK_SAMPLES_PER_SYMBOL; ++i)
+    {
+      PSKDemod_push( &psk, cosine_table( BAM16toBAM8( angle ) ) >> 2, &symbol, &bits );
+      angle += carrier;
+    }
+  }
+  // Includes generating the test signal
+  report( F("PSKDemod_push per symbol"), PSK_SAMPLES_PER_SYMBOL, (cyclesRead() * BENCH_REPEATS) / PSK_SYMBOLS, PSK_SAMPLES_PER_SYMBOL );
+}
+
+static void benchCW( void )
+{
+  CWDecoder cw;
+  BAM16 tone = FREQUENCY_HZtoBAM16_PER_SAMPLE( 700, 8000 );
+  BAM16 angle = 0;
+  uint32_t pushCycles = 0;
+  uint32_t decodeMax = 0;
+
+  CW_init( &cw, tone, CW_BLOCK, CW_DIT_BLOCKS_Q8( 20, 8000, CW_BLOCK ) );
+  for( int b=0; b<CW_BLOCKS; ++b)
+  {
+    // "A": dit, gap, dah then the letter gap
+    int dits = b / CW_DIT_BLOCKS;
+    bool keyed = (0 == dits) || (2 <= dits && dits < 5);
+    for( int i=0; i<CW_BLOCK; ++i)
+    {
+      scratch.real[i] = keyed ? cosine_table( BAM16toBAM8( angle ) ) >> 2 : 0;
+      angle += tone;
+    }
+
+    cyclesStart();
+    for( int i=0; i<CW_BLOCK; ++i)
+    {
+      CW_push( &cw, scratch.real[i] );
+    }
+    pushCycles += cyclesRead();
+
+    cyclesStart();
+    volatile char c = CW_decode( &cw );
+    uint32_t cycles = cyclesRead();
+    (void)c;
+    decodeMax = max( decodeMax, cycles );
+  }
+  report( F("CW_push per block"), CW_BLOCK, (pushCycles * BENCH_REPEATS) / CW_BLOCKS, CW_BLOCK );
+  report( F("CW_decode worst block"), CW_BLOCK, decodeMax * BENCH_REPEATS, CW_BLOCK );
+}
+
+void setup()
+{
+  Serial.begin( 115200 );
+
+  // Resonant test signal so the recursion runs to full order
+  BAM16 angle = 0;
+  for( int i=0; i<LPC_FRAME; ++i)
+  {
+    frame[i] = (cosine_lerp( angle ) >> 1) + (int16_t)random( -2048, 2048 );
+    angle += FREQUENCY_HZtoBAM16_PER_SAMPLE( 700, 8000 );
+  }
+
+#if defined(FPDSP_AVR_ASM)
+  verifyASM();
+#endif
+  benchCORDIC();
+  benchMAC();
+  benchFFT();
+  benchLPC();
+  benchPSK();
+  benchCW();
+
+  Serial.println( F("done") );
+  Serial.flush();
+
+#if defined(BENCH_HALT)
+  // simavr exits when the CPU sleeps with interrupts off
+  cli();
+  sleep_enable();
+  sleep_cpu();
+#endif
+}
+
+void loop()
+{
+}
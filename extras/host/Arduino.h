@@ -0,0 +1,135 @@
+/**
+ * @file    Arduino.h
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Minimal stand in for the Arduino core so the portable parts of fpDSP can be
+ * built and run on a desktop host. Put this directory on the include path
+ * ahead of any real Arduino core.
+ *
+ * PROGMEM data lives in ordinary memory and the pgm_read_* macros are plain
+ * loads. The ATmega328P registers used by samples.cpp are declared here as
+ * plain variables, defined in avr_registers.cpp, so the ADC stream code can
+ * be driven by a host harness. ISR(vector) declares an ordinary function the
+ * harness calls to simulate the interrupt, and micros() reads hostMicros,
+ * the harness's simulated clock, so timestamps taken in that code are
+ * repeatable and can be checked.
+ *
+ */
+#ifndef   ARDUINO_HOST_H
+#define   ARDUINO_HOST_H
+
+/* Includes ******************************************************************/
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#ifdef __cplusplus
+#include <algorithm>
+#endif
+
+/* Defines *******************************************************************/
+#define PROGMEM
+#define F(s) (s)
+
+#define pgm_read_byte(p)  (*(const uint8_t*)(p))
+#define pgm_read_word(p)  (*(const uint16_t*)(p))
+#define pgm_read_dword(p) (*(const uint32_t*)(p))
+#define pgm_read_ptr(p)   (*(const void* const*)(p))
+
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+#define bit(b) (1UL << (b))
+
+#define A0 14
+
+// An ATmega328P board, as the Timer 1 setup in samples.cpp assumes
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#ifdef __cplusplus
+#define ISR(vector, ...) extern "C" void vector( void )
+#else
+#define ISR(vector, ...) void vector( void )
+#endif
+
+// Timer 1 bits
+#define WGM10  0
+#define WGM11  1
+#define CS10   0
+#define CS11   1
+#define CS12   2
+#define WGM12  3
+#define WGM13  4
+#define TOIE1  0
+#define OCIE1A 1
+#define OCIE1B 2
+#define TOV1   0
+#define OCF1A  1
+#define OCF1B  2
+
+// ADC bits
+#define REFS1  7
+#define REFS0  6
+#define ADLAR  5
+#define ADEN   7
+#define ADSC   6
+#define ADATE  5
+#define ADIF   4
+#define ADIE   3
+#define ADTS2  2
+#define ADTS1  1
+#define ADTS0  0
+
+/* Data **********************************************************************/
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern volatile uint8_t  TCCR1A;
+extern volatile uint8_t  TCCR1B;
+extern volatile uint16_t TCNT1;
+extern volatile uint16_t OCR1A;
+extern volatile uint16_t OCR1B;
+extern volatile uint8_t  TIMSK1;
+extern volatile uint8_t  TIFR1;
+
+extern volatile uint8_t  ADMUX;
+extern volatile uint8_t  ADCSRA;
+extern volatile uint8_t  ADCSRB;
+extern volatile uint16_t ADC;
+
+// The simulated time in microseconds, set by the harness
+extern volatile unsigned long hostMicros;
+
+/**
+ * Returns ADC, set by the harness.
+ */
+int analogRead( uint8_t pin );
+
+#ifdef __cplusplus
+}
+#endif
+
+/* Functions *****************************************************************/
+#ifdef __cplusplus
+using std::min;
+using std::max;
+#endif
+
+static inline void noInterrupts( void ) {}
+static inline void interrupts( void ) {}
+
+static inline unsigned long micros( void )
+{
+  return hostMicros;
+}
+
+static inline unsigned long millis( void )
+{
+  return micros() / 1000;
+}
+
+#endif // ARDUINO_HOST_H
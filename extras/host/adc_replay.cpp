@@ -0,0 +1,495 @@
+/**
+ * @file    adc_replay.cpp
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Replays recorded or synthetic ADC values through the real ADC stream code
+ * of samples.cpp on a host, to measure buffer headroom and latency.
+ *
+ * ADC_StreamSetup, or ADC_StreamSetupRate with -r, is called as on the board
+ * and each sample period is taken back from the Timer 1 registers it
+ * programs, after StreamRate_step where the TIMER1_COMPB_vect ISR would call
+ * it. Time is then simulated in nanoseconds: a conversion completes at the
+ * end of every period, and the ADC_vect ISR
+ * below runs after an interrupt latency plus a random jitter standing in
+ * for code that masks interrupts. If the ISR has not read ADC by the time
+ * the next conversion completes, the value is overwritten and counted as an
+ * ADC overrun. The main loop pops blocks with SampleBuffer_popAllOrNothing
+ * whenever enough samples are waiting and is busy for the block cost, plus
+ * any ISR time that preempts it.
+ *
+ * micros() follows the simulated clock, so each popped block is also checked
+ * to start at the stream index that SampleBuffer_tell gives for it, and the
+ * stamp's time to be the capture time of the first sample in its stamped
+ * block.
+ *
+ * The ISR keeps a StreamMonitor as a board would. TCNT1 is set to the time
+ * since the conversion completed when it runs, so its latencies are from
+ * completion rather than from the trigger, and its figures are printed
+ * next to the harness's own as a cross check.
+ *
+ * The same seed always gives the same run, so changes to block size,
+ * processing cost or code can be compared exactly.
+ *
+ *     adc_replay -p 125 -b 64 -c 5000 -j 40
+ *     adc_replay -r 11025 -b 64 -c 4000
+ *     adc_replay -i capture.wav -p 100 -b 128 -c 11000 -o delivered.raw
+ *
+ * WAV input is mapped to 10 bit ADC counts with full scale at the ADC rails;
+ * any other file is read as decimal ADC counts, for example a Serial dump.
+ *
+ * Build from the repository root with
+ *
+ *     g++ -O2 -I extras/host -I . extras/host/adc_replay.cpp extras/host/wav.cpp \
+ *         extras/host/avr_registers.cpp samples.cpp DSP.cpp -o adc_replay
+ *
+ */
+
+/* Includes ******************************************************************/
+#include <Arduino.h>
+#include "DSP.h"
+#include "samples.h"
+#include "wav.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+/* Defines *******************************************************************/
+#define NS_PER_US 1000LL
+
+// Interval histogram buckets, in percent of the nominal period
+#define HISTOGRAM_BUCKETS 8
+#define HISTOGRAM_STEP    25
+
+
+/* Types *********************************************************************/
+typedef struct Options
+{
+  int         period_us;
+  uint32_t    rate_Hz;
+  int         block;
+  double      blockCost_us;
+  double      isrLatency_us;
+  double      isrCost_us;
+  double      jitter_us;
+  uint32_t    seed;
+  long        count;
+  double      toneHz;
+  double      toneAmplitude;
+  const char* input;
+  const char* output;
+} Options;
+
+typedef struct Stats
+{
+  long      delivered;
+  long      adcOverruns;
+  long      bufferOverruns;
+  int       highWater;
+  long long intervalMin;
+  long long intervalMax;
+  long long intervalSum;
+  long      intervals;
+  long      histogram[HISTOGRAM_BUCKETS];
+  long long latencyMin;
+  long long latencyMax;
+  long long latencySum;
+  long      blocks;
+  long long busy;
+  long      mismatches;
+} Stats;
+
+/* Data **********************************************************************/
+// CPU cycles per Timer 1 tick by CS12:0
+static const int PRESCALES[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+
+static SampleBuffer buffer;
+
+// Capture time of the sample in each buffer slot
+static long long captured[SAMPLE_BUFFER_SIZE];
+static long long now;
+static StreamMonitor monitor;
+
+// TCNT1 when the ISR under test finishes
+static uint16_t isrEndTicks;
+
+/* Functions *****************************************************************/
+
+/**
+ * The ISR under test, the monitored pattern from samples.h.
+ */
+ISR(ADC_vect)
+{
+  uint16_t start = StreamMonitor_begin( &monitor );
+  captured[buffer.in] = now;
+  StreamMonitor_push( &monitor, &buffer, ADC_readCurrentSample() );
+  TCNT1 = isrEndTicks;
+  StreamMonitor_end( &monitor, start );
+}
+
+static uint32_t xorshift( uint32_t* state )
+{
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+static void usage( void )
+{
+  fprintf( stderr,
+    "usage: adc_replay [options]\n"
+    "  -p us       sample period passed to ADC_StreamSetup (125)\n"
+    "  -r hz       sample rate passed to ADC_StreamSetupRate, in place of -p\n"
+    "  -b n        samples per block popped by the main loop (64)\n"
+    "  -c us       main loop processing time per block (1000)\n"
+    "  -l us       ISR entry latency (1)\n"
+    "  -e us       ISR execution time (3)\n"
+    "  -j us       maximum extra ISR latency from masked interrupts (0)\n"
+    "  -x seed     jitter seed (1)\n"
+    "  -n samples  samples to replay (all input, or 8 seconds)\n"
+    "  -t hz:amp   synthetic tone when there is no input (1000:0.5)\n"
+    "  -i file     WAV or decimal ADC count input\n"
+    "  -o file     write the samples the main loop received as s16le\n" );
+}
+
+static bool loadInput( const char* path, std::vector<uint16_t>& adc )
+{
+  WavFile wav;
+  if( Wav_open( &wav, path ) )
+  {
+    std::vector<Q_15> frame( wav.channels );
+    while( Wav_read( &wav, frame.data(), 1 ) == 1 )
+    {
+      adc.push_back( (frame[0] >> 6) + 0x200 );
+    }
+    Wav_close( &wav );
+    return true;
+  }
+
+  FILE* f = fopen( path, "r" );
+  if( !f )
+  {
+    return false;
+  }
+  int v;
+  while( fscanf( f, "%d", &v ) == 1 )
+  {
+    adc.push_back( constrain( v, 0, 0x3FF ) );
+  }
+  fclose( f );
+  return !adc.empty();
+}
+
+static void synthesize( const Options* opt, double rate, std::vector<uint16_t>& adc )
+{
+  for( long n = 0; n < opt->count; ++n )
+  {
+    double x = opt->toneAmplitude * sin( 2 * M_PI * opt->toneHz * n / rate );
+    adc.push_back( constrain( lround( 0x200 + 0x1FF * x ), 0L, 0x3FFL ) );
+  }
+}
+
+static double us( long long ns )
+{
+  return ns / (double)NS_PER_US;
+}
+
+int main( int argc, char** argv )
+{
+  Options opt;
+  memset( &opt, 0, sizeof(opt) );
+  opt.period_us = PERIOD_US_8KHZ;
+  opt.block = 64;
+  opt.blockCost_us = 1000;
+  opt.isrLatency_us = 1;
+  opt.isrCost_us = 3;
+  opt.seed = 1;
+  opt.toneHz = 1000;
+  opt.toneAmplitude = 0.5;
+
+  int c;
+  while( (c = getopt( argc, argv, "p:r:b:c:l:e:j:x:n:t:i:o:" )) != -1 )
+  {
+    switch( c )
+    {
+      case 'p': opt.period_us = atoi( optarg ); break;
+      case 'r': opt.rate_Hz = strtoul( optarg, NULL, 0 ); break;
+      case 'b': opt.block = atoi( optarg ); break;
+      case 'c': opt.blockCost_us = atof( optarg ); break;
+      case 'l': opt.isrLatency_us = atof( optarg ); break;
+      case 'e': opt.isrCost_us = atof( optarg ); break;
+      case 'j': opt.jitter_us = atof( optarg ); break;
+      case 'x': opt.seed = strtoul( optarg, NULL, 0 ); break;
+      case 'n': opt.count = atol( optarg ); break;
+      case 't': sscanf( optarg, "%lf:%lf", &opt.toneHz, &opt.toneAmplitude ); break;
+      case 'i': opt.input = optarg; break;
+      case 'o': opt.output = optarg; break;
+      default:
+        usage();
+        return 2;
+    }
+  }
+  if( opt.period_us < 1 || opt.block < 1 || opt.block >= SAMPLE_BUFFER_SIZE || opt.seed == 0 )
+  {
+    usage();
+    return 2;
+  }
+
+  // Program the stream as the board would and read back the period
+  StreamRate streamRate;
+  if( opt.rate_Hz )
+  {
+    if( !ADC_StreamSetupRate( A0, opt.rate_Hz, &streamRate ) )
+    {
+      fprintf( stderr, "adc_replay: can not sample at %" PRIu32 " Hz\n", opt.rate_Hz );
+      return 2;
+    }
+  }
+  else
+  {
+    ADC_StreamSetup( A0, opt.period_us );
+  }
+  const int cyclesPerTick = PRESCALES[TCCR1B & 0x07];
+  const double nsPerTick = 1e9 * cyclesPerTick / F_CPU;
+  const long long period = opt.rate_Hz ? llround( 1e9 / opt.rate_Hz ) : llround( (OCR1A + 1) * nsPerTick );
+  const double rate = opt.rate_Hz ? opt.rate_Hz : 1e9 / period;
+  StreamMonitor_reset( &monitor );
+
+  std::vector<uint16_t> adc;
+  if( opt.input )
+  {
+    if( !loadInput( opt.input, adc ) )
+    {
+      fprintf( stderr, "adc_replay: can not read %s\n", opt.input );
+      return 1;
+    }
+    if( opt.count > 0 && (size_t)opt.count < adc.size() )
+    {
+      adc.resize( opt.count );
+    }
+  }
+  else
+  {
+    if( opt.count <= 0 )
+    {
+      opt.count = (long)(8 * rate);
+    }
+    synthesize( &opt, rate, adc );
+  }
+
+  FILE* out = NULL;
+  if( opt.output && !(out = fopen( opt.output, "wb" )) )
+  {
+    perror( opt.output );
+    return 1;
+  }
+
+  const long long isrLatency = llround( opt.isrLatency_us * NS_PER_US );
+  const long long isrCost = llround( opt.isrCost_us * NS_PER_US );
+  const long long jitter = llround( opt.jitter_us * NS_PER_US );
+  const long long blockCost = llround( opt.blockCost_us * NS_PER_US );
+
+  Stats st;
+  memset( &st, 0, sizeof(st) );
+  st.intervalMin = st.latencyMin = 1LL << 62;
+
+  SampleBuffer_init( &buffer );
+  std::vector<Q_15> block( opt.block );
+  std::vector<Q_15> blockCaptured;
+  uint32_t rng = opt.seed;
+
+  // Delivered samples in order, to check against what the main loop gets
+  std::vector<Q_15> expected;
+  std::vector<long long> expectedTime;
+  size_t checked = 0;
+
+  long long isrFree = 0;       // end of the last ISR
+  long long mainFree = 0;      // end of the block being processed
+  long long blockStart = 0;
+  bool processing = false;
+  std::vector<long long> inFlight;
+  long long lastDispatch = -1;
+  long long cycles = 0;        // CPU cycle the next conversion completes on
+
+  // Time since a conversion completed as a Timer 1 count
+  auto ticksSince = [&]( long long ns )
+  {
+    return (uint16_t)((ns * (long long)(F_CPU / 1000000) / cyclesPerTick / NS_PER_US) % monitor.period);
+  };
+
+  // Runs the main loop up to time t
+  auto advanceMain = [&]( long long t )
+  {
+    for( ;; )
+    {
+      if( processing )
+      {
+        if( mainFree > t )
+        {
+          return;
+        }
+        for( long long cap : inFlight )
+        {
+          long long latency = mainFree - cap;
+          st.latencyMin = std::min( st.latencyMin, latency );
+          st.latencyMax = std::max( st.latencyMax, latency );
+          st.latencySum += latency;
+        }
+        st.busy += mainFree - blockStart;
+        processing = false;
+      }
+
+      long long start = std::max( mainFree, isrFree );
+      if( start > t || SampleBuffer_size( &buffer ) < opt.block )
+      {
+        return;
+      }
+
+      inFlight.clear();
+      for( int i = 0; i < opt.block; ++i )
+      {
+        inFlight.push_back( captured[(uint8_t)(buffer.out + i)] );
+      }
+      SampleStamp stamp;
+      st.mismatches += SampleBuffer_tell( &buffer, &stamp ) != checked;
+      size_t stamped = checked - (buffer.out & (SAMPLE_BLOCK_SIZE - 1));
+      st.mismatches += stamp.time_us != (uint32_t)(expectedTime[stamped] / NS_PER_US);
+      SampleBuffer_popAllOrNothing( &buffer, block.data(), opt.block );
+      for( int i = 0; i < opt.block; ++i, ++checked )
+      {
+        st.mismatches += block[i] != expected[checked];
+      }
+      if( out )
+      {
+        fwrite( block.data(), sizeof(Q_15), opt.block, out );
+      }
+
+      ++st.blocks;
+      blockStart = start;
+      mainFree = start + blockCost;
+      processing = true;
+    }
+  };
+
+  for( size_t n = 0; n < adc.size(); ++n )
+  {
+    long long complete = cycles * 1000000000LL / F_CPU;
+    if( opt.rate_Hz )
+    {
+      // The TIMER1_COMPB_vect ISR sets the length of the period just started
+      StreamRate_step( &streamRate );
+    }
+    cycles += (long long)(OCR1A + 1) * cyclesPerTick;
+    long long next = cycles * 1000000000LL / F_CPU;
+    long long extra = jitter ? xorshift( &rng ) % (jitter + 1) : 0;
+    long long dispatch = std::max( complete + isrLatency + extra, isrFree );
+    StreamMonitor_trigger( &monitor );
+
+    if( dispatch >= next && n + 1 < adc.size() )
+    {
+      // ADC already holds the next conversion, ADIF only remembers one
+      ++st.adcOverruns;
+      continue;
+    }
+
+    advanceMain( dispatch );
+
+    if( lastDispatch >= 0 )
+    {
+      long long interval = dispatch - lastDispatch;
+      st.intervalMin = std::min( st.intervalMin, interval );
+      st.intervalMax = std::max( st.intervalMax, interval );
+      st.intervalSum += interval;
+      ++st.intervals;
+      int bucket = (int)(interval * 100 / period / HISTOGRAM_STEP);
+      ++st.histogram[std::min( bucket, HISTOGRAM_BUCKETS - 1 )];
+    }
+    lastDispatch = dispatch;
+
+    now = complete;
+    hostMicros = (unsigned long)(complete / NS_PER_US);
+    ADC = adc[n];
+    TCNT1 = ticksSince( dispatch - complete );
+    isrEndTicks = ticksSince( dispatch + isrCost - complete );
+    long dropped = monitor.overruns;
+    ADC_vect();
+    if( monitor.overruns == dropped )
+    {
+      expected.push_back( (Q_15)((adc[n] - 0x200) << 4) );
+      expectedTime.push_back( complete );
+      ++st.delivered;
+    }
+    st.highWater = std::max( st.highWater, SampleBuffer_size( &buffer ) );
+
+    isrFree = dispatch + isrCost;
+    if( processing && mainFree > dispatch )
+    {
+      // the ISR preempts the main loop
+      mainFree += isrCost;
+    }
+  }
+  advanceMain( 1LL << 62 );
+  ADC_StreamStop();
+  st.bufferOverruns = monitor.overruns;
+
+  if( out )
+  {
+    fclose( out );
+  }
+
+  long long duration = cycles * 1000000000LL / F_CPU;
+  int headroom = (SAMPLE_BUFFER_SIZE - 1) - st.highWater;
+
+  if( opt.rate_Hz )
+  {
+    printf( "rate        %" PRIu32 " Hz: %u + %" PRIu32 "/%" PRIu32 " ticks of %d cycles, achieved %.3f Hz, jitter %u ns\n",
+            opt.rate_Hz, streamRate.ticks, streamRate.fraction, streamRate.rate, cyclesPerTick,
+            streamRate.achieved_mHz / 1000.0, streamRate.jitter_ns );
+    printf( "replayed    %.3f Hz mean over %.3f s\n", duration ? adc.size() * 1e9 / duration : 0.0, duration / 1e9 );
+  }
+  else
+  {
+    printf( "period      %.3f us (OCR1A %u), %.2f Hz\n", us( period ), (unsigned)OCR1A, rate );
+  }
+  printf( "samples     %zu replayed, %ld delivered, %ld processed\n", adc.size(), st.delivered, st.blocks * opt.block );
+  printf( "overruns    %ld ADC, %ld buffer\n", st.adcOverruns, st.bufferOverruns );
+  printf( "buffer      high water %d of %d, headroom %d samples = %.1f us\n",
+          st.highWater, SAMPLE_BUFFER_SIZE - 1, headroom, us( headroom * period ) );
+  if( st.intervals )
+  {
+    printf( "ISR period  min %.2f avg %.2f max %.2f us\n", us( st.intervalMin ),
+            us( st.intervalSum / st.intervals ), us( st.intervalMax ) );
+    printf( "histogram  " );
+    for( int i = 0; i < HISTOGRAM_BUCKETS - 1; ++i )
+    {
+      printf( " <%d%%:%ld", (i + 1) * HISTOGRAM_STEP, st.histogram[i] );
+    }
+    printf( " >=%d%%:%ld\n", (HISTOGRAM_BUCKETS - 1) * HISTOGRAM_STEP, st.histogram[HISTOGRAM_BUCKETS - 1] );
+  }
+  if( st.blocks )
+  {
+    printf( "latency     min %.1f avg %.1f max %.1f us capture to processed\n", us( st.latencyMin ),
+            us( st.latencySum / (st.blocks * opt.block) ), us( st.latencyMax ) );
+  }
+  StreamMonitor sm;
+  StreamMonitor_read( &monitor, &sm );
+  printf( "monitor     high water %u, overruns %" PRIu32 ", missed %" PRIu32 ", max latency %.1f us, max ISR %.1f us\n",
+          sm.highWater, sm.overruns, sm.missed, sm.maxLatency * nsPerTick / NS_PER_US,
+          sm.maxDuration * nsPerTick / NS_PER_US );
+  printf( "jitter     " );
+  for( int i = 0; i < STREAM_HISTOGRAM_BINS - 1; ++i )
+  {
+    printf( " <%d:%" PRIu32, 1 << i, sm.intervals[i] );
+  }
+  printf( " >=%d:%" PRIu32, 1 << (STREAM_HISTOGRAM_BINS - 2), sm.intervals[STREAM_HISTOGRAM_BINS - 1] );
+  printf( " ticks\n" );
+  printf( "main load   %.1f%%\n", duration ? 100.0 * st.busy / duration : 0.0 );
+  printf( "data        %ld mismatches\n", st.mismatches );
+
+  return (st.adcOverruns || st.bufferOverruns || st.mismatches) ? 1 : 0;
+}
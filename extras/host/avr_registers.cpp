@@ -0,0 +1,36 @@
+/**
+ * @file    avr_registers.cpp
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Storage for the simulated ATmega328P registers and clock declared in the
+ * host Arduino.h.
+ *
+ */
+
+/* Includes ******************************************************************/
+#include <Arduino.h>
+
+/* Data **********************************************************************/
+volatile uint8_t  TCCR1A;
+volatile uint8_t  TCCR1B;
+volatile uint16_t TCNT1;
+volatile uint16_t OCR1A;
+volatile uint16_t OCR1B;
+volatile uint8_t  TIMSK1;
+volatile uint8_t  TIFR1;
+
+volatile uint8_t  ADMUX;
+volatile uint8_t  ADCSRA;
+volatile uint8_t  ADCSRB;
+volatile uint16_t ADC;
+
+volatile unsigned long hostMicros;
+
+/* Functions *****************************************************************/
+
+int analogRead( uint8_t pin )
+{
+  (void)pin;
+  return ADC;
+}
@@ -0,0 +1,528 @@
+/**
+ * @file    fpdsp_batch.cpp
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Offline batch analysis of long recordings with the same fixed point code
+ * the boards run.
+ *
+ * Each input is memory mapped and cut into analysis windows of 2^order
+ * samples, one every hop samples. Input that can't be mapped in place, 8 bit
+ * or big endian hosts, is converted a segment of windows at a time. Runs of consecutive windows form chunks,
+ * overlapping by 2^order - hop samples, which a pool of worker threads analyse
+ * independently. Results are written in input order as chunks complete, and
+ * workers never run more than a few chunks ahead of the writer, so memory
+ * stays bounded whatever the file length.
+ *
+ *     fpdsp_batch -a spectrum -n 8 -w hann capture.wav > spectra.csv
+ *     fpdsp_batch -a tone -j 16 -b -o tones.bin *.wav
+ *     fpdsp_batch -a power -f 1000 -r 8000 capture.raw
+ *
+ * CSV output has a header row and one row per window starting with the file
+ * and the window start time in seconds. Binary output is little endian, one
+ * record per window: a uint32_t window index followed by
+ *  - spectrum: 2^(order-1) Q_15 bins
+ *  - tone:     int32_t bin, Q16_15 THD, SNR and SINAD in dB
+ *  - power:    Q16_15 power
+ *
+ * Build from the repository root with
+ *
+ *     g++ -O2 -pthread -I extras/host -I . extras/host/fpdsp_batch.cpp \
+ *         extras/host/wav.cpp DSP.cpp measurement.cpp -o fpdsp_batch
+ *
+ */
+
+/* Includes ******************************************************************/
+#include <Arduino.h>
+#include "DSP.h"
+#include "measurement.h"
+#include "wav.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Defines *******************************************************************/
+#define MAX_ORDER 8
+
+// Windows per chunk handed to a worker
+#define CHUNK_WINDOWS 256
+
+// How many chunks the workers may get ahead of the writer, per thread
+#define CHUNKS_AHEAD 4
+
+// Chunks per thread converted at once when the input isn't mapped
+#define SEGMENT_CHUNKS 8
+
+/* Types *********************************************************************/
+typedef enum Analysis
+{
+  ANALYSIS_SPECTRUM,
+  ANALYSIS_TONE,
+  ANALYSIS_POWER,
+} Analysis;
+
+typedef struct Options
+{
+  Analysis    analysis;
+  int         order;
+  int         hop;          ///< 0 for half a window
+  bool        hann;
+  double      freqHz;       ///< for ANALYSIS_POWER
+  int         channel;
+  int         threads;
+  uint32_t    rawRate;      ///< nonzero to read headerless s16le input
+  int         rawChannels;
+  bool        binary;
+  const char* output;
+} Options;
+
+/**
+ * One input file as seen by the workers, a strided view of one channel.
+ */
+typedef struct Input
+{
+  const char* path;
+  const Q_15* data;
+  int         stride;
+  uint32_t    offset;       ///< frame of the file at data[0]
+  uint32_t    sampleRate;
+  uint32_t    firstWindow;  ///< windows to analyse, firstWindow..windows-1
+  uint32_t    windows;
+} Input;
+
+typedef struct Chunk
+{
+  std::string out;
+  bool        done;
+} Chunk;
+
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+static void usage( void )
+{
+  fprintf( stderr,
+    "usage: fpdsp_batch [options] file...\n"
+    "  -a spectrum|tone|power  analysis to run (spectrum)\n"
+    "  -n order                window of 2^order samples, <= %d (8)\n"
+    "  -h hop                  samples between windows (half a window)\n"
+    "  -w hann|rect            window for spectrum (rect)\n"
+    "  -f hz                   frequency for power\n"
+    "  -c channel              channel to analyse (0)\n"
+    "  -j threads              worker threads (all cores)\n"
+    "  -r rate                 headerless s16le input at rate\n"
+    "  -m channels             channels in headerless input (1)\n"
+    "  -b                      binary output\n"
+    "  -o file                 output file (stdout)\n",
+    MAX_ORDER );
+}
+
+static void put32( std::string& out, uint32_t v )
+{
+  char b[4] = { (char)v, (char)(v >> 8), (char)(v >> 16), (char)(v >> 24) };
+  out.append( b, 4 );
+}
+
+static void put16( std::string& out, uint16_t v )
+{
+  char b[2] = { (char)v, (char)(v >> 8) };
+  out.append( b, 2 );
+}
+
+static void appendf( std::string& out, const char* fmt, ... )
+{
+  char buf[64];
+  va_list args;
+  va_start( args, fmt );
+  int n = vsnprintf( buf, sizeof(buf), fmt, args );
+  va_end( args );
+  out.append( buf, n < (int)sizeof(buf) ? n : (int)sizeof(buf) - 1 );
+}
+
+static double fromQ16_15( Q16_15 x )
+{
+  return x / 32768.0;
+}
+
+static void header( FILE* out, const Options* opt )
+{
+  int N = 1 << opt->order;
+  switch( opt->analysis )
+  {
+    case ANALYSIS_SPECTRUM:
+      fputs( "file,time_s", out );
+      for( int i = 0; i < N / 2; ++i )
+      {
+        fprintf( out, ",bin%d", i );
+      }
+      fputc( '\n', out );
+      break;
+    case ANALYSIS_TONE:
+      fputs( "file,time_s,bin,freq_hz,thd_db,snr_db,sinad_db\n", out );
+      break;
+    case ANALYSIS_POWER:
+      fputs( "file,time_s,power\n", out );
+      break;
+  }
+}
+
+/**
+ * Analyses one window and appends the result to out.
+ */
+static void analyse( std::string& out, const Options* opt, const Input* in, uint32_t window, Q_15* buf, Q_15* spectrum )
+{
+  const int N = 1 << opt->order;
+  const uint32_t start = window * (uint32_t)opt->hop;
+
+  for( int i = 0; i < N; ++i )
+  {
+    buf[i] = in->data[(size_t)(start - in->offset + i) * in->stride];
+  }
+
+  if( opt->binary )
+  {
+    put32( out, window );
+  }
+  else
+  {
+    appendf( out, "%s,%.6f", in->path, (double)start / in->sampleRate );
+  }
+
+  switch( opt->analysis )
+  {
+    case ANALYSIS_SPECTRUM:
+      if( opt->hann )
+      {
+        Window_hann( buf, opt->order );
+      }
+      FFT_magnitude( spectrum, buf, opt->order );
+      for( int i = 0; i < N / 2; ++i )
+      {
+        if( opt->binary )
+        {
+          put16( out, spectrum[i] );
+        }
+        else
+        {
+          appendf( out, ",%d", spectrum[i] );
+        }
+      }
+      break;
+
+    case ANALYSIS_TONE:
+    {
+      AudioQuality q;
+      int bin = AudioQuality_measure( &q, buf, opt->order, AUDIO_QUALITY_DEFAULT_HARMONICS, AUDIO_QUALITY_BLACKMAN_HARRIS );
+      if( !bin )
+      {
+        q.thd_dB = q.snr_dB = q.sinad_dB = 0;
+      }
+      if( opt->binary )
+      {
+        put32( out, bin );
+        put32( out, q.thd_dB );
+        put32( out, q.snr_dB );
+        put32( out, q.sinad_dB );
+      }
+      else
+      {
+        appendf( out, ",%d,%.1f,%.2f,%.2f,%.2f", bin, (double)bin * in->sampleRate / N,
+                 fromQ16_15( q.thd_dB ), fromQ16_15( q.snr_dB ), fromQ16_15( q.sinad_dB ) );
+      }
+      break;
+    }
+
+    case ANALYSIS_POWER:
+    {
+      BAM16 freq = (BAM16)(opt->freqHz * 65536.0 / in->sampleRate + 0.5);
+      Q16_15 power = powerMeasurement_magnitude( buf, freq, N );
+      if( opt->binary )
+      {
+        put32( out, power );
+      }
+      else
+      {
+        appendf( out, ",%d", power );
+      }
+      break;
+    }
+  }
+
+  if( !opt->binary )
+  {
+    out.push_back( '\n' );
+  }
+}
+
+/**
+ * Runs the analysis over one input on a pool of threads, writing the chunks
+ * in order as they complete.
+ */
+static bool process( FILE* out, const Options* opt, const Input* in )
+{
+  const uint32_t chunks = (in->windows - in->firstWindow + CHUNK_WINDOWS - 1) / CHUNK_WINDOWS;
+  const uint32_t ahead = CHUNKS_AHEAD * opt->threads;
+
+  std::vector<Chunk> results( chunks );
+  std::mutex lock;
+  std::condition_variable changed;
+  std::atomic<uint32_t> next( 0 );
+  uint32_t written = 0;
+
+  auto worker = [&]()
+  {
+    const int N = 1 << opt->order;
+    std::vector<Q_15> buf( N );
+    std::vector<Q_15> spectrum( N );
+
+    for( ;; )
+    {
+      uint32_t chunk = next++;
+      if( chunk >= chunks )
+      {
+        return;
+      }
+
+      {
+        std::unique_lock<std::mutex> guard( lock );
+        changed.wait( guard, [&]{ return chunk < written + ahead; } );
+      }
+
+      std::string text;
+      uint32_t first = in->firstWindow + chunk * CHUNK_WINDOWS;
+      uint32_t last = std::min( first + CHUNK_WINDOWS, in->windows );
+      for( uint32_t w = first; w < last; ++w )
+      {
+        analyse( text, opt, in, w, buf.data(), spectrum.data() );
+      }
+
+      std::lock_guard<std::mutex> guard( lock );
+      results[chunk].out.swap( text );
+      results[chunk].done = true;
+      changed.notify_all();
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for( int t = 0; t < opt->threads; ++t )
+  {
+    pool.emplace_back( worker );
+  }
+
+  bool ok = true;
+  while( written < chunks )
+  {
+    std::string text;
+    {
+      std::unique_lock<std::mutex> guard( lock );
+      changed.wait( guard, [&]{ return results[written].done; } );
+      text.swap( results[written].out );
+    }
+    ok = fwrite( text.data(), 1, text.size(), out ) == text.size() && ok;
+
+    std::lock_guard<std::mutex> guard( lock );
+    ++written;
+    changed.notify_all();
+  }
+
+  for( auto& t : pool )
+  {
+    t.join();
+  }
+  return ok;
+}
+
+/**
+ * Runs the analysis over an input that isn't mapped, converting a segment of
+ * windows at a time. Samples shared with the next segment are kept, and
+ * gaps between windows are skipped.
+ *
+ * @return false if the output failed
+ */
+static bool processSegments( FILE* out, const Options* opt, Input* in, WavFile* wav, int channel )
+{
+  const uint32_t N = 1u << opt->order;
+  const uint32_t hop = opt->hop;
+  const uint32_t segment = SEGMENT_CHUNKS * CHUNK_WINDOWS * opt->threads;
+  const uint32_t windows = in->windows;
+
+  std::vector<Q_15> copy( ((size_t)(segment - 1) * hop + N) * wav->channels );
+  uint32_t have = 0;
+  in->offset = 0;
+  in->data = copy.data() + channel;
+
+  for( uint32_t first = 0; first < windows; first += segment )
+  {
+    const uint32_t start = first * hop;
+    const uint32_t last = std::min( first + segment, windows );
+    const uint32_t end = (last - 1) * hop + N;
+
+    if( start < in->offset + have )
+    {
+      uint32_t keep = in->offset + have - start;
+      memmove( copy.data(), copy.data() + (size_t)(start - in->offset) * wav->channels,
+               (size_t)keep * wav->channels * sizeof(Q_15) );
+      have = keep;
+    }
+    else
+    {
+      if( !Wav_seek( wav, start ) )
+      {
+        break;
+      }
+      have = 0;
+    }
+    in->offset = start;
+
+    uint32_t want = end - start - have;
+    uint32_t got = Wav_read( wav, copy.data() + (size_t)have * wav->channels, want );
+    have += got;
+
+    // A short read ends the file at the last whole window
+    in->firstWindow = first;
+    in->windows = (got < want) ? (have < N ? first : first + (have - N) / hop + 1) : last;
+    if( in->windows > first && !process( out, opt, in ) )
+    {
+      return false;
+    }
+    if( got < want )
+    {
+      break;
+    }
+  }
+  return true;
+}
+
+static bool parseAnalysis( const char* name, Analysis* analysis )
+{
+  if( !strcmp( name, "spectrum" ) )
+  {
+    *analysis = ANALYSIS_SPECTRUM;
+  }
+  else if( !strcmp( name, "tone" ) )
+  {
+    *analysis = ANALYSIS_TONE;
+  }
+  else if( !strcmp( name, "power" ) )
+  {
+    *analysis = ANALYSIS_POWER;
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+int main( int argc, char** argv )
+{
+  Options opt;
+  memset( &opt, 0, sizeof(opt) );
+  opt.order = 8;
+  opt.rawChannels = 1;
+  opt.threads = std::thread::hardware_concurrency();
+
+  int c;
+  while( (c = getopt( argc, argv, "a:n:h:w:f:c:j:r:m:bo:" )) != -1 )
+  {
+    switch( c )
+    {
+      case 'a':
+        if( !parseAnalysis( optarg, &opt.analysis ) )
+        {
+          usage();
+          return 2;
+        }
+        break;
+      case 'n': opt.order = atoi( optarg ); break;
+      case 'h': opt.hop = atoi( optarg ); break;
+      case 'w': opt.hann = !strcmp( optarg, "hann" ); break;
+      case 'f': opt.freqHz = atof( optarg ); break;
+      case 'c': opt.channel = atoi( optarg ); break;
+      case 'j': opt.threads = atoi( optarg ); break;
+      case 'r': opt.rawRate = atoi( optarg ); break;
+      case 'm': opt.rawChannels = atoi( optarg ); break;
+      case 'b': opt.binary = true; break;
+      case 'o': opt.output = optarg; break;
+      default:
+        usage();
+        return 2;
+    }
+  }
+
+  if( optind >= argc || opt.order < 2 || opt.order > MAX_ORDER ||
+      opt.hop < 0 || opt.rawChannels < 1 || opt.channel < 0 ||
+      (opt.rawRate && opt.channel >= opt.rawChannels) ||
+      (opt.analysis == ANALYSIS_POWER && opt.freqHz <= 0) )
+  {
+    usage();
+    return 2;
+  }
+  if( opt.hop == 0 )
+  {
+    opt.hop = 1 << (opt.order - 1);
+  }
+  opt.threads = std::max( opt.threads, 1 );
+
+  FILE* out = opt.output ? fopen( opt.output, opt.binary ? "wb" : "w" ) : stdout;
+  if( !out )
+  {
+    perror( opt.output );
+    return 1;
+  }
+  if( !opt.binary )
+  {
+    header( out, &opt );
+  }
+
+  int status = 0;
+  for( int i = optind; i < argc; ++i )
+  {
+    WavFile wav;
+    bool opened = opt.rawRate ? Wav_openRaw( &wav, argv[i], opt.rawRate, opt.rawChannels )
+                              : Wav_open( &wav, argv[i] );
+    if( !opened || opt.channel >= wav.channels )
+    {
+      fprintf( stderr, "%s: not a 8/16 bit PCM file with channel %d\n", argv[i], opt.channel );
+      status = 1;
+      continue;
+    }
+
+    Input in;
+    in.path = argv[i];
+    in.stride = wav.channels;
+    in.offset = 0;
+    in.sampleRate = wav.sampleRate;
+    in.firstWindow = 0;
+    in.windows = wav.frames < (1u << opt.order) ? 0 :
+                 (wav.frames - (1u << opt.order)) / opt.hop + 1;
+
+    // Analyse in place when mapped, otherwise convert a segment at a time
+    const Q_15* data = Wav_map( &wav );
+    in.data = data ? data + opt.channel : NULL;
+    bool ok = data ? process( out, &opt, &in )
+                   : processSegments( out, &opt, &in, &wav, opt.channel );
+    if( !ok )
+    {
+      perror( opt.output ? opt.output : "stdout" );
+      status = 1;
+    }
+    Wav_close( &wav );
+  }
+
+  if( out != stdout && fclose( out ) )
+  {
+    perror( opt.output );
+    status = 1;
+  }
+  return status;
+}
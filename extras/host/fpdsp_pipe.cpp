@@ -0,0 +1,674 @@
+/**
+ * @file    fpdsp_pipe.cpp
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Streams raw s16le PCM from stdin through a chain of fixed point stages and
+ * writes the result to stdout, for use in shell pipelines.
+ *
+ *     arecord -f S16_LE -r 8000 | fpdsp_pipe iir:hp:300 agc | aplay -f S16_LE -r 8000
+ *     fpdsp_pipe -r 48000 resample:1:6 fir:lp:3400 < in.raw | fpdsp_pipe -t fft:8:hann
+ *
+ * Stages, applied left to right:
+ *  - fir:lp:HZ[:TAPS]     windowed sinc low pass, 31 taps by default
+ *  - fir:FILE             taps from a file, one per line as floats in [-1, 1)
+ *  - iir:TYPE:HZ[:Q]      biquad of TYPE lp, hp, bp or notch, Q 0.707 by default
+ *  - resample:UP:DOWN     polyphase rate change by UP/DOWN
+ *  - agc[:DBFS]           automatic gain towards DBFS, -12 by default
+ *  - fft:ORDER[:hann]     FFT_magnitude of consecutive 2^ORDER blocks, must be
+ *                         last, giving 2^(ORDER-1) bins per block
+ *
+ * Output is s16le samples or bins, or decimal text with -t, one sample or one
+ * block of bins per line. Input is read with whatever read() returns up to
+ * the block size and every stage works in place where it can, so latency is
+ * bounded by one block and samples are not copied between stages.
+ *
+ * Build from the repository root with
+ *
+ *     g++ -O2 -I extras/host -I . extras/host/fpdsp_pipe.cpp DSP.cpp -o fpdsp_pipe
+ *
+ * Add -DFPDSP_PROFILE and profile.cpp to time the kernels and the first four
+ * stages (STAGE0-3), then -p FILE writes a Chrome trace at the end of input.
+ *
+ */
+
+/* Includes ******************************************************************/
+#include <Arduino.h>
+#include "DSP.h"
+#include "profile.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/* Defines *******************************************************************/
+// Samples per read from stdin
+#define BLOCK_SIZE 4096
+
+#define FIR_DEFAULT_TAPS 31
+#define FIR_MAX_TAPS     256  // Q15_MAC is overflow safe to 256
+
+// Taps of the resampling filter per max(up,down), spread over the up phases
+#define RESAMPLE_TAPS 16
+#define RESAMPLE_MAX  64
+
+#define AGC_MAX_GAIN  (64 << 8)  // 36 dB in UQ8_8
+#define AGC_UPDATE    16         // samples between gain updates
+
+/* Types *********************************************************************/
+
+/**
+ * One processing stage. Stages that keep the sample count work in place and
+ * return buf; others return their own buffer and update count.
+ */
+class Stage
+{
+public:
+  virtual ~Stage() {}
+  virtual Q_15* process( Q_15* buf, int& count ) = 0;
+};
+
+/* Data **********************************************************************/
+static uint32_t sampleRate = 8000;
+
+/* Functions *****************************************************************/
+
+static Q_15 toQ15( double x )
+{
+  long v = lround( x * 32768.0 );
+  return (Q_15)constrain( v, -32768L, 32767L );
+}
+
+static Q1_14 toQ1_14( double x )
+{
+  long v = lround( x * 16384.0 );
+  return (Q1_14)constrain( v, -32768L, 32767L );
+}
+
+/**
+ * Hann windowed sinc low pass with unity gain at DC scaled by gain.
+ *
+ * @param cutoff the cutoff as a fraction of the sample rate
+ */
+static std::vector<double> designLowpass( int taps, double cutoff, double gain )
+{
+  std::vector<double> h( taps );
+  double sum = 0;
+  for( int i = 0; i < taps; ++i )
+  {
+    double t = i - (taps - 1) / 2.0;
+    double sinc = (t == 0) ? 2 * cutoff : sin( 2 * M_PI * cutoff * t ) / (M_PI * t);
+    h[i] = sinc * (0.5 - 0.5 * cos( 2 * M_PI * (i + 1) / (taps + 1) ));
+    sum += h[i];
+  }
+  for( auto& x : h )
+  {
+    x *= gain / sum;
+  }
+  return h;
+}
+
+/**
+ * A delay line stored twice over, so the last taps samples are always
+ * contiguous for Q15_MAC without moving any data.
+ */
+class DelayLine
+{
+public:
+  explicit DelayLine( int taps ) : line( 2 * taps ), taps( taps ), pos( 0 ) {}
+
+  void push( Q_15 x )
+  {
+    line[pos] = x;
+    line[pos + taps] = x;
+    if( ++pos == taps )
+    {
+      pos = 0;
+    }
+  }
+
+  // oldest first
+  Q_15* window() { return &line[pos]; }
+
+private:
+  std::vector<Q_15> line;
+  int taps;
+  int pos;
+};
+
+class FirStage : public Stage
+{
+public:
+  explicit FirStage( const std::vector<double>& h ) : coeffs( h.size() ), delay( h.size() )
+  {
+    // reversed to line up with the oldest first delay line
+    for( size_t i = 0; i < h.size(); ++i )
+    {
+      coeffs[h.size() - 1 - i] = toQ15( h[i] );
+    }
+  }
+
+  Q_15* process( Q_15* buf, int& count )
+  {
+    for( int i = 0; i < count; ++i )
+    {
+      delay.push( buf[i] );
+      Q16_15 y = Q15_MAC( coeffs.data(), delay.window(), coeffs.size() );
+      buf[i] = Q15_sat( y );
+    }
+    return buf;
+  }
+
+private:
+  std::vector<Q_15> coeffs;
+  DelayLine delay;
+};
+
+class IirStage : public Stage
+{
+public:
+  explicit IirStage( const Biquad16Coeffs& c ) : coeffs( c )
+  {
+    Biquad16_init( &state );
+  }
+
+  Q_15* process( Q_15* buf, int& count )
+  {
+    for( int i = 0; i < count; ++i )
+    {
+      buf[i] = Biquad16_step( &state, &coeffs, buf[i] );
+    }
+    return buf;
+  }
+
+private:
+  Biquad16Coeffs coeffs;
+  Biquad16 state;
+};
+
+/**
+ * Rational rate change by up/down with a polyphase low pass.
+ */
+class ResampleStage : public Stage
+{
+public:
+  ResampleStage( int up, int down ) :
+    up( up ), down( down ), phase( 0 ),
+    taps( (std::max( up, down ) * RESAMPLE_TAPS + up - 1) / up ), delay( taps )
+  {
+    // The transition band narrows with max(up,down), so the filter grows
+    // with it. Each phase's taps sum to about 1, which keeps Q15_MAC clear
+    // of overflow even past 256 taps when decimating.
+    double cutoff = 0.45 / std::max( up, down );
+    std::vector<double> h = designLowpass( up * taps, cutoff, up );
+
+    // phase p uses h[p + k*up] against x[n-k], stored oldest first
+    polyphase.resize( up * taps );
+    for( int p = 0; p < up; ++p )
+    {
+      for( int k = 0; k < taps; ++k )
+      {
+        polyphase[p * taps + taps - 1 - k] = toQ15( h[p + k * up] );
+      }
+    }
+  }
+
+  Q_15* process( Q_15* buf, int& count )
+  {
+    out.resize( (size_t)count * up / down + 1 );
+    int n = 0;
+    for( int i = 0; i < count; ++i )
+    {
+      delay.push( buf[i] );
+      for( ; phase < up; phase += down )
+      {
+        Q16_15 y = Q15_MAC( &polyphase[phase * taps], delay.window(), taps );
+        out[n++] = Q15_sat( y );
+      }
+      phase -= up;
+    }
+    count = n;
+    return out.data();
+  }
+
+private:
+  int up;
+  int down;
+  int phase;
+  int taps;      ///< per phase
+  DelayLine delay;
+  std::vector<Q_15> polyphase;
+  std::vector<Q_15> out;
+};
+
+/**
+ * Peak following gain control. The envelope rises fast and decays slowly,
+ * and the gain is recomputed from it every AGC_UPDATE samples.
+ */
+class AgcStage : public Stage
+{
+public:
+  explicit AgcStage( double dBFS ) : target( toQ15( pow( 10, dBFS / 20 ) ) ), envelope( 0 ), gain( 1 << 8 ), n( 0 ) {}
+
+  Q_15* process( Q_15* buf, int& count )
+  {
+    for( int i = 0; i < count; ++i )
+    {
+      // envelope in Q_15 with 8 extra fraction bits
+      int32_t level = (int32_t)abs( buf[i] ) << 8;
+      envelope += (level > envelope) ? (level - envelope) >> 2 : (level - envelope) >> 12;
+
+      if( ++n == AGC_UPDATE )
+      {
+        n = 0;
+        int32_t e = (envelope >> 8) + 1;
+        gain = std::min( ((int32_t)target << 8) / e, (int32_t)AGC_MAX_GAIN );
+      }
+
+      int32_t y = ((int32_t)buf[i] * gain) >> 8;
+      buf[i] = Q15_sat( y );
+    }
+    return buf;
+  }
+
+private:
+  Q_15 target;
+  int32_t envelope;
+  int32_t gain;   ///< UQ8_8
+  int n;
+};
+
+class FftStage : public Stage
+{
+public:
+  FftStage( int order, bool hann ) : order( order ), hann( hann ), fill( 0 ), block( 1 << order ), bins( 1 << order ) {}
+
+  Q_15* process( Q_15* buf, int& count )
+  {
+    const int N = 1 << order;
+    int n = 0;
+    out.resize( ((size_t)(fill + count) / N) * (N / 2) );
+    for( int i = 0; i < count; ++i )
+    {
+      block[fill++] = buf[i];
+      if( fill == N )
+      {
+        fill = 0;
+        if( hann )
+        {
+          Window_hann( block.data(), order );
+        }
+        FFT_magnitude( bins.data(), block.data(), order );
+        memcpy( &out[n], bins.data(), (N / 2) * sizeof(Q_15) );
+        n += N / 2;
+      }
+    }
+    count = n;
+    return out.data();
+  }
+
+  int width() const { return 1 << (order - 1); }
+
+private:
+  int order;
+  bool hann;
+  int fill;
+  std::vector<Q_15> block;
+  std::vector<Q_15> bins;
+  std::vector<Q_15> out;
+};
+
+static void usage( void )
+{
+  fprintf( stderr,
+    "usage: fpdsp_pipe [-r rate] [-t] stage...\n"
+    "  -r rate               input sample rate in Hz (8000)\n"
+    "  -t                    write decimal text instead of s16le\n"
+    "  -p FILE               write a Chrome trace, with FPDSP_PROFILE\n"
+    "stages:\n"
+    "  fir:lp:HZ[:TAPS]      windowed sinc low pass\n"
+    "  fir:FILE              taps from a file\n"
+    "  iir:lp|hp|bp|notch:HZ[:Q]\n"
+    "  resample:UP:DOWN      up to %d each\n"
+    "  agc[:DBFS]\n"
+    "  fft:ORDER[:hann]      last stage only, ORDER <= 8\n",
+    RESAMPLE_MAX );
+}
+
+/**
+ * RBJ audio EQ cookbook biquads.
+ */
+static bool designBiquad( Biquad16Coeffs* c, const std::string& type, double hz, double q )
+{
+  double w = 2 * M_PI * hz / sampleRate;
+  double alpha = sin( w ) / (2 * q);
+  double cw = cos( w );
+  double b0, b1, b2;
+
+  if( type == "lp" )
+  {
+    b0 = b2 = (1 - cw) / 2;
+    b1 = 1 - cw;
+  }
+  else if( type == "hp" )
+  {
+    b0 = b2 = (1 + cw) / 2;
+    b1 = -(1 + cw);
+  }
+  else if( type == "bp" )
+  {
+    b0 = alpha;
+    b1 = 0;
+    b2 = -alpha;
+  }
+  else if( type == "notch" )
+  {
+    b0 = b2 = 1;
+    b1 = -2 * cw;
+  }
+  else
+  {
+    return false;
+  }
+
+  double a0 = 1 + alpha;
+  c->b0 = toQ1_14( b0 / a0 );
+  c->b1 = toQ1_14( b1 / a0 );
+  c->b2 = toQ1_14( b2 / a0 );
+  c->a1 = toQ1_14( -2 * cw / a0 );
+  c->a2 = toQ1_14( (1 - alpha) / a0 );
+  return true;
+}
+
+static std::vector<std::string> split( const char* arg )
+{
+  std::vector<std::string> parts;
+  std::string s( arg );
+  size_t start = 0;
+  for( ;; )
+  {
+    size_t colon = s.find( ':', start );
+    parts.push_back( s.substr( start, colon - start ) );
+    if( colon == std::string::npos )
+    {
+      return parts;
+    }
+    start = colon + 1;
+  }
+}
+
+static bool readTaps( const char* path, std::vector<double>& h )
+{
+  FILE* f = fopen( path, "r" );
+  if( !f )
+  {
+    return false;
+  }
+  double x;
+  while( fscanf( f, "%lf", &x ) == 1 && h.size() < FIR_MAX_TAPS )
+  {
+    h.push_back( x );
+  }
+  fclose( f );
+  return !h.empty();
+}
+
+/**
+ * Builds a stage from its command line description, updating sampleRate for
+ * the stages that follow.
+ */
+static Stage* parseStage( const char* arg, FftStage** fft )
+{
+  std::vector<std::string> p = split( arg );
+  const std::string& name = p[0];
+
+  if( name == "fir" && p.size() >= 2 )
+  {
+    std::vector<double> h;
+    if( p[1] == "lp" && p.size() >= 3 )
+    {
+      int taps = p.size() > 3 ? atoi( p[3].c_str() ) : FIR_DEFAULT_TAPS;
+      if( taps < 1 || taps > FIR_MAX_TAPS )
+      {
+        return NULL;
+      }
+      h = designLowpass( taps, atof( p[2].c_str() ) / sampleRate, 1.0 );
+    }
+    else if( !readTaps( arg + 4, h ) )
+    {
+      return NULL;
+    }
+    return new FirStage( h );
+  }
+
+  if( name == "iir" && p.size() >= 3 )
+  {
+    Biquad16Coeffs c;
+    double q = p.size() > 3 ? atof( p[3].c_str() ) : M_SQRT1_2;
+    if( q <= 0 || !designBiquad( &c, p[1], atof( p[2].c_str() ), q ) )
+    {
+      return NULL;
+    }
+    return new IirStage( c );
+  }
+
+  if( name == "resample" && p.size() == 3 )
+  {
+    int up = atoi( p[1].c_str() );
+    int down = atoi( p[2].c_str() );
+    if( up < 1 || down < 1 || up > RESAMPLE_MAX || down > RESAMPLE_MAX )
+    {
+      return NULL;
+    }
+    sampleRate = (uint64_t)sampleRate * up / down;
+    return new ResampleStage( up, down );
+  }
+
+  if( name == "agc" )
+  {
+    return new AgcStage( p.size() > 1 ? atof( p[1].c_str() ) : -12.0 );
+  }
+
+  if( name == "fft" && p.size() >= 2 )
+  {
+    int order = atoi( p[1].c_str() );
+    if( order < 2 || order > 8 )
+    {
+      return NULL;
+    }
+    *fft = new FftStage( order, p.size() > 2 && p[2] == "hann" );
+    return *fft;
+  }
+
+  return NULL;
+}
+
+static bool writeAll( const void* data, size_t size )
+{
+  const char* p = (const char*)data;
+  while( size )
+  {
+    ssize_t n = write( STDOUT_FILENO, p, size );
+    if( n < 0 && errno == EINTR )
+    {
+      continue;
+    }
+    if( n <= 0 )
+    {
+      return false;
+    }
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+/**
+ * Writes samples as s16le, or as text with width values per line.
+ */
+static bool output( const Q_15* buf, int count, bool text, int width )
+{
+  if( !text )
+  {
+    // s16le, byte swapped copies only on big endian hosts
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    std::vector<uint8_t> le( count * 2 );
+    for( int i = 0; i < count; ++i )
+    {
+      le[2 * i] = buf[i];
+      le[2 * i + 1] = (uint16_t)buf[i] >> 8;
+    }
+    return writeAll( le.data(), le.size() );
+#else
+    return writeAll( buf, count * sizeof(Q_15) );
+#endif
+  }
+
+  std::string s;
+  char num[8];
+  for( int i = 0; i < count; ++i )
+  {
+    snprintf( num, sizeof(num), "%d", buf[i] );
+    s += num;
+    s += ((i + 1) % width) ? ' ' : '\n';
+  }
+  return writeAll( s.data(), s.size() );
+}
+
+/**
+ * Writes the kernel and stage timings, if built with FPDSP_PROFILE.
+ *
+ * @param path the trace file, or NULL for none
+ */
+static void writeTrace( const char* path )
+{
+  if( !path )
+  {
+    return;
+  }
+#if defined(FPDSP_PROFILE)
+  FILE* f = fopen( path, "w" );
+  if( !f || !Profile_writeChromeTrace( f ) )
+  {
+    perror( path );
+  }
+  if( f )
+  {
+    fclose( f );
+  }
+#else
+  fprintf( stderr, "fpdsp_pipe: built without FPDSP_PROFILE, no trace written\n" );
+#endif
+}
+
+int main( int argc, char** argv )
+{
+  bool text = false;
+  const char* tracePath = NULL;
+  int c;
+  while( (c = getopt( argc, argv, "r:tp:" )) != -1 )
+  {
+    switch( c )
+    {
+      case 'r': sampleRate = atoi( optarg ); break;
+      case 't': text = true; break;
+      case 'p': tracePath = optarg; break;
+      default:
+        usage();
+        return 2;
+    }
+  }
+  if( sampleRate == 0 )
+  {
+    usage();
+    return 2;
+  }
+
+  std::vector<std::unique_ptr<Stage>> chain;
+  FftStage* fft = NULL;
+  for( int i = optind; i < argc; ++i )
+  {
+    if( fft )
+    {
+      fprintf( stderr, "fpdsp_pipe: fft must be the last stage\n" );
+      return 2;
+    }
+    Stage* stage = parseStage( argv[i], &fft );
+    if( !stage )
+    {
+      fprintf( stderr, "fpdsp_pipe: bad stage '%s'\n", argv[i] );
+      usage();
+      return 2;
+    }
+    chain.emplace_back( stage );
+  }
+  int width = fft ? fft->width() : 1;
+
+#if defined(FPDSP_PROFILE)
+  Profile_reset();
+#endif
+
+  static Q_15 samples[BLOCK_SIZE];
+  uint8_t* in = (uint8_t*)samples;
+  size_t have = 0;
+
+  for( ;; )
+  {
+    ssize_t n = read( STDIN_FILENO, in + have, sizeof(samples) - have );
+    if( n < 0 && errno == EINTR )
+    {
+      continue;
+    }
+    if( n < 0 )
+    {
+      perror( "fpdsp_pipe: stdin" );
+      return 1;
+    }
+    if( n == 0 )
+    {
+      writeTrace( tracePath );
+      return 0;
+    }
+    have += n;
+
+    // s16le is used in place, only big endian hosts need to swap
+    int count = have / 2;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for( int i = 0; i < count; ++i )
+    {
+      samples[i] = (Q_15)(in[2 * i] | (in[2 * i + 1] << 8));
+    }
+#endif
+
+    // an odd trailing byte is kept in a spare sample for the next read
+    uint8_t odd = in[have - 1];
+    have &= 1;
+
+    Q_15* buf = samples;
+    int s = 0;
+    for( auto& stage : chain )
+    {
+#if defined(FPDSP_PROFILE)
+      ProfileTicks start = Profile_now();
+#endif
+      buf = stage->process( buf, count );
+#if defined(FPDSP_PROFILE)
+      if( PROFILE_STAGE0 + s <= PROFILE_STAGE3 )
+      {
+        Profile_record( (ProfileId)(PROFILE_STAGE0 + s), start );
+      }
+#endif
+      ++s;
+    }
+    if( count && !output( buf, count, text, width ) )
+    {
+      return errno == EPIPE ? 0 : 1;
+    }
+    in[0] = odd;
+  }
+}
@@ -0,0 +1,434 @@
+/**
+ * @file    wav.cpp
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Streaming WAV reader and writer.
+ *
+ */
+
+/* Includes ******************************************************************/
+#include "wav.h"
+
+#include <string.h>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* Defines *******************************************************************/
+#define WAVE_FORMAT_PCM        0x0001
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+#define WAV_HEADER_SIZE 44
+
+// Bytes converted per fread when not memory mapped
+#define WAV_CHUNK 4096
+
+/* Types *********************************************************************/
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+static uint16_t get16( const uint8_t* p )
+{
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32( const uint8_t* p )
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put16( uint8_t* p, uint16_t v )
+{
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static void put32( uint8_t* p, uint32_t v )
+{
+  put16( p, v );
+  put16( p + 2, v >> 16 );
+}
+
+static bool hostLittleEndian( void )
+{
+  const uint16_t probe = 1;
+  return *(const uint8_t*)&probe == 1;
+}
+
+/**
+ * Walks the RIFF chunks for fmt and data.
+ */
+static bool parseHeader( WavFile* wav )
+{
+  uint8_t header[12];
+  if( fread( header, 1, 12, wav->file ) != 12 ||
+      memcmp( header, "RIFF", 4 ) || memcmp( header + 8, "WAVE", 4 ) )
+  {
+    return false;
+  }
+
+  bool haveFormat = false;
+  uint8_t chunk[8];
+  while( fread( chunk, 1, 8, wav->file ) == 8 )
+  {
+    uint32_t size = get32( chunk + 4 );
+
+    if( !memcmp( chunk, "fmt ", 4 ) && size >= 16 )
+    {
+      uint8_t fmt[40] = {0};
+      uint32_t take = size < sizeof(fmt) ? size : sizeof(fmt);
+      if( fread( fmt, 1, take, wav->file ) != take )
+      {
+        return false;
+      }
+      uint16_t format = get16( fmt );
+      if( format == WAVE_FORMAT_EXTENSIBLE && take >= 26 )
+      {
+        // first two bytes of the sub format GUID
+        format = get16( fmt + 24 );
+      }
+      wav->channels = get16( fmt + 2 );
+      wav->sampleRate = get32( fmt + 4 );
+      wav->bitsPerSample = get16( fmt + 14 );
+      if( format != WAVE_FORMAT_PCM || wav->channels == 0 ||
+          (wav->bitsPerSample != 8 && wav->bitsPerSample != 16) )
+      {
+        return false;
+      }
+      haveFormat = true;
+      size -= take;
+    }
+    else if( !memcmp( chunk, "data", 4 ) && haveFormat )
+    {
+      wav->dataOffset = ftell( wav->file );
+      wav->frames = size / (wav->channels * (wav->bitsPerSample >> 3));
+      return true;
+    }
+
+    // chunks are padded to an even size
+    if( fseek( wav->file, size + (size & 1), SEEK_CUR ) )
+    {
+      return false;
+    }
+  }
+  return false;
+}
+
+/**
+ * Maps the whole file if the platform allows, otherwise leaves map NULL.
+ */
+static void mapFile( WavFile* wav )
+{
+#if defined(__linux__)
+  int fd = fileno( wav->file );
+  struct stat st;
+  if( fstat( fd, &st ) || st.st_size <= 0 )
+  {
+    return;
+  }
+
+  void* map = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+  if( map == MAP_FAILED )
+  {
+    return;
+  }
+  madvise( map, st.st_size, MADV_SEQUENTIAL );
+  wav->map = (const uint8_t*)map;
+  wav->mapSize = st.st_size;
+
+  // a truncated file reports a data size past the end
+  uint32_t frameBytes = wav->channels * (wav->bitsPerSample >> 3);
+  uint32_t available = (wav->mapSize - wav->dataOffset) / frameBytes;
+  if( wav->frames > available )
+  {
+    wav->frames = available;
+  }
+#else
+  (void)wav;
+#endif
+}
+
+bool Wav_open( WavFile* wav, const char* path )
+{
+  memset( wav, 0, sizeof(*wav) );
+  wav->file = fopen( path, "rb" );
+  if( !wav->file )
+  {
+    return false;
+  }
+  if( !parseHeader( wav ) )
+  {
+    fclose( wav->file );
+    wav->file = NULL;
+    return false;
+  }
+  mapFile( wav );
+  return true;
+}
+
+bool Wav_openRaw( WavFile* wav, const char* path, uint32_t sampleRate, uint16_t channels )
+{
+  memset( wav, 0, sizeof(*wav) );
+  if( channels == 0 )
+  {
+    return false;
+  }
+  wav->file = fopen( path, "rb" );
+  if( !wav->file )
+  {
+    return false;
+  }
+  wav->sampleRate = sampleRate;
+  wav->channels = channels;
+  wav->bitsPerSample = 16;
+
+  long size = -1;
+  if( fseek( wav->file, 0, SEEK_END ) == 0 )
+  {
+    size = ftell( wav->file );
+  }
+  if( size < 0 || fseek( wav->file, 0, SEEK_SET ) )
+  {
+    fclose( wav->file );
+    wav->file = NULL;
+    return false;
+  }
+  wav->frames = size / (2 * channels);
+  mapFile( wav );
+  return true;
+}
+
+/**
+ * Converts count little endian samples of the file's width to Q_15.
+ */
+static void toQ15( const WavFile* wav, Q_15* dst, const uint8_t* src, size_t count )
+{
+  if( wav->bitsPerSample == 8 )
+  {
+    for( size_t i = 0; i < count; ++i )
+    {
+      dst[i] = (Q_15)((src[i] - 128) << 8);
+    }
+  }
+  else if( hostLittleEndian() )
+  {
+    memcpy( dst, src, count * sizeof(Q_15) );
+  }
+  else
+  {
+    for( size_t i = 0; i < count; ++i )
+    {
+      dst[i] = (Q_15)get16( src + 2 * i );
+    }
+  }
+}
+
+int Wav_read( WavFile* wav, Q_15* dst, int frames )
+{
+  if( !wav->file || wav->writing || frames <= 0 )
+  {
+    return 0;
+  }
+
+  uint32_t remaining = wav->frames - wav->position;
+  if( (uint32_t)frames > remaining )
+  {
+    frames = remaining;
+  }
+
+  size_t sampleBytes = wav->bitsPerSample >> 3;
+  size_t count = (size_t)frames * wav->channels;
+
+  if( wav->map )
+  {
+    const uint8_t* src = wav->map + wav->dataOffset +
+                         (size_t)wav->position * wav->channels * sampleBytes;
+    toQ15( wav, dst, src, count );
+    wav->position += frames;
+    return frames;
+  }
+
+  uint8_t buf[WAV_CHUNK];
+  size_t perChunk = WAV_CHUNK / sampleBytes;
+  size_t done = 0;
+  while( done < count )
+  {
+    size_t want = count - done < perChunk ? count - done : perChunk;
+    size_t got = fread( buf, sampleBytes, want, wav->file );
+    toQ15( wav, dst + done, buf, got );
+    done += got;
+    if( got < want )
+    {
+      break;
+    }
+  }
+
+  frames = done / wav->channels;
+  wav->position += frames;
+  return frames;
+}
+
+bool Wav_seek( WavFile* wav, uint32_t frame )
+{
+  if( !wav->file || wav->writing || frame > wav->frames )
+  {
+    return false;
+  }
+  if( !wav->map )
+  {
+    long offset = wav->dataOffset + (long)frame * wav->channels * (wav->bitsPerSample >> 3);
+    if( fseek( wav->file, offset, SEEK_SET ) )
+    {
+      return false;
+    }
+  }
+  wav->position = frame;
+  return true;
+}
+
+const Q_15* Wav_map( WavFile* wav )
+{
+  // Q_15 access needs 2 byte alignment, the data offset is normally even
+  if( !wav->map || wav->bitsPerSample != 16 || (wav->dataOffset & 1) || !hostLittleEndian() )
+  {
+    return NULL;
+  }
+  return (const Q_15*)(wav->map + wav->dataOffset);
+}
+
+/**
+ * Writes the canonical 44 byte header with the current sizes.
+ */
+static bool writeHeader( WavFile* wav )
+{
+  uint32_t blockAlign = wav->channels * (wav->bitsPerSample >> 3);
+  uint32_t dataSize = wav->frames * blockAlign;
+  uint8_t h[WAV_HEADER_SIZE];
+
+  memcpy( h, "RIFF", 4 );
+  put32( h + 4, 36 + dataSize + (dataSize & 1) );
+  memcpy( h + 8, "WAVEfmt ", 8 );
+  put32( h + 16, 16 );
+  put16( h + 20, WAVE_FORMAT_PCM );
+  put16( h + 22, wav->channels );
+  put32( h + 24, wav->sampleRate );
+  put32( h + 28, wav->sampleRate * blockAlign );
+  put16( h + 32, blockAlign );
+  put16( h + 34, wav->bitsPerSample );
+  memcpy( h + 36, "data", 4 );
+  put32( h + 40, dataSize );
+
+  return fseek( wav->file, 0, SEEK_SET ) == 0 &&
+         fwrite( h, 1, WAV_HEADER_SIZE, wav->file ) == WAV_HEADER_SIZE;
+}
+
+bool Wav_create( WavFile* wav, const char* path, uint32_t sampleRate, uint16_t channels, uint16_t bitsPerSample )
+{
+  memset( wav, 0, sizeof(*wav) );
+  if( channels == 0 || (bitsPerSample != 8 && bitsPerSample != 16) )
+  {
+    return false;
+  }
+
+  wav->file = fopen( path, "wb" );
+  if( !wav->file )
+  {
+    return false;
+  }
+  wav->writing = true;
+  wav->sampleRate = sampleRate;
+  wav->channels = channels;
+  wav->bitsPerSample = bitsPerSample;
+  wav->dataOffset = WAV_HEADER_SIZE;
+
+  // sizes are patched in by Wav_close
+  if( !writeHeader( wav ) )
+  {
+    fclose( wav->file );
+    wav->file = NULL;
+    return false;
+  }
+  return true;
+}
+
+int Wav_write( WavFile* wav, const Q_15* src, int frames )
+{
+  if( !wav->file || !wav->writing || frames <= 0 )
+  {
+    return 0;
+  }
+
+  size_t sampleBytes = wav->bitsPerSample >> 3;
+  size_t count = (size_t)frames * wav->channels;
+  size_t perChunk = WAV_CHUNK / sampleBytes;
+  uint8_t buf[WAV_CHUNK];
+  size_t done = 0;
+
+  while( done < count )
+  {
+    size_t n = count - done < perChunk ? count - done : perChunk;
+    const Q_15* s = src + done;
+    if( sampleBytes == 1 )
+    {
+      for( size_t i = 0; i < n; ++i )
+      {
+        int v = (s[i] + 0x80) >> 8;
+        buf[i] = (v > 127 ? 127 : v) + 128;
+      }
+    }
+    else
+    {
+      for( size_t i = 0; i < n; ++i )
+      {
+        put16( buf + 2 * i, s[i] );
+      }
+    }
+
+    size_t put = fwrite( buf, sampleBytes, n, wav->file );
+    done += put;
+    if( put < n )
+    {
+      break;
+    }
+  }
+
+  frames = done / wav->channels;
+  wav->frames += frames;
+  return frames;
+}
+
+bool Wav_close( WavFile* wav )
+{
+  if( !wav->file )
+  {
+    return false;
+  }
+
+  bool ok = true;
+  if( wav->writing )
+  {
+    uint32_t dataSize = wav->frames * wav->channels * (wav->bitsPerSample >> 3);
+    if( dataSize & 1 )
+    {
+      ok = fputc( 0, wav->file ) != EOF;
+    }
+    ok = writeHeader( wav ) && ok;
+  }
+
+#if defined(__linux__)
+  if( wav->map )
+  {
+    munmap( (void*)wav->map, wav->mapSize );
+  }
+#endif
+
+  ok = fclose( wav->file ) == 0 && ok;
+  memset( wav, 0, sizeof(*wav) );
+  return ok;
+}
@@ -0,0 +1,133 @@
+/**
+ * @file    wav.h
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Streaming WAV reader and writer for host side testing with real recordings.
+ *
+ * Handles 8 and 16 bit PCM with any number of channels, including the
+ * WAVE_FORMAT_EXTENSIBLE header. Samples are converted to and from Q_15 in
+ * blocks of interleaved frames, so files of any length can be processed in
+ * fixed memory. On Linux a reader memory maps the file, and 16 bit files can
+ * be accessed in place with Wav_map.
+ *
+ *     WavFile in;
+ *     Q_15 block[256];
+ *     if( Wav_open( &in, "tone.wav" ) )
+ *     {
+ *       while( Wav_read( &in, block, 256 ) == 256 )
+ *         FFT_magnitude( spectrum, block, 8 );
+ *       Wav_close( &in );
+ *     }
+ *
+ * https://en.wikipedia.org/wiki/WAV
+ *
+ */
+#ifndef   WAV_H
+#define   WAV_H
+
+/* Includes ******************************************************************/
+#include <inttypes.h>
+#include <stdio.h>
+#include "DSP.h"
+
+/* Defines *******************************************************************/
+/* Types *********************************************************************/
+typedef struct WavFile
+{
+  FILE*    file;
+  uint32_t sampleRate;
+  uint16_t channels;
+  uint16_t bitsPerSample;
+  uint32_t frames;       ///< frames in the file, or written so far
+  uint32_t position;     ///< next frame to read
+  long     dataOffset;   ///< file offset of the sample data
+  bool     writing;
+
+  const uint8_t* map;    ///< whole file when memory mapped, else NULL
+  size_t         mapSize;
+} WavFile;
+
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+/**
+ * Opens a WAV file for reading and parses its header.
+ *
+ * @param wav the WavFile to initialize
+ * @param path the file to open
+ * @return true if the file is 8 or 16 bit PCM and was opened
+ */
+bool Wav_open( WavFile* wav, const char* path );
+
+/**
+ * Opens a headerless file of 16 bit little endian PCM for reading.
+ *
+ * @param wav the WavFile to initialize
+ * @param path the file to open
+ * @param sampleRate samples per second per channel
+ * @param channels number of interleaved channels
+ * @return true if the file was opened
+ */
+bool Wav_openRaw( WavFile* wav, const char* path, uint32_t sampleRate, uint16_t channels );
+
+/**
+ * Reads interleaved frames converted to Q_15.
+ *
+ * @param wav the WavFile
+ * @param dst where to write frames * channels samples
+ * @param frames the number of frames wanted
+ * @return the number of frames read, less than frames at the end of the file
+ */
+int Wav_read( WavFile* wav, Q_15* dst, int frames );
+
+/**
+ * Moves the read position.
+ *
+ * @param wav the WavFile
+ * @param frame the frame to read next
+ * @return true if frame is within the file
+ */
+bool Wav_seek( WavFile* wav, uint32_t frame );
+
+/**
+ * Returns the sample data in place when it is memory mapped 16 bit little
+ * endian PCM on a little endian host, avoiding any copying.
+ *
+ * @param wav the WavFile
+ * @return frames * channels interleaved samples, or NULL if not available
+ */
+const Q_15* Wav_map( WavFile* wav );
+
+/**
+ * Creates a WAV file for writing.
+ *
+ * @param wav the WavFile to initialize
+ * @param path the file to create
+ * @param sampleRate samples per second per channel
+ * @param channels number of interleaved channels
+ * @param bitsPerSample 8 or 16
+ * @return true if the file was created
+ */
+bool Wav_create( WavFile* wav, const char* path, uint32_t sampleRate, uint16_t channels, uint16_t bitsPerSample );
+
+/**
+ * Writes interleaved Q_15 frames, rounding to 8 bits if needed.
+ *
+ * @param wav the WavFile
+ * @param src frames * channels samples
+ * @param frames the number of frames to write
+ * @return the number of frames written
+ */
+int Wav_write( WavFile* wav, const Q_15* src, int frames );
+
+/**
+ * Closes the file. For a file being written the header sizes are filled in.
+ *
+ * @param wav the WavFile
+ * @return true if everything was written successfully
+ */
+bool Wav_close( WavFile* wav );
+
+#endif // WAV_H
@@ -0,0 +1,36 @@
+#!/bin/sh
+#
+# Builds examples/Benchmark for an ATmega328P and runs it in simavr, printing
+# exact cycle counts for each kernel per call and per sample.
+#
+# Needs arduino-cli with the arduino:avr core installed and simavr, neither
+# of which needs network access once installed:
+#
+#     arduino-cli core install arduino:avr
+#     apt install simavr
+#
+# Usage: extras/simavr/benchmark.sh [build directory]
+#
+# Set FPDSP_USE_ASM=1 to build the AVR assembly kernels, which the sketch then
+# checks against the C versions before timing both.
+#
+set -e
+
+ROOT=$(cd "$(dirname "$0")/../.." && pwd)
+BUILD=${1:-"$ROOT/build/simavr"}
+F_CPU=16000000
+FLAGS=-DBENCH_HALT
+if [ -n "$FPDSP_USE_ASM" ]; then
+  FLAGS="$FLAGS -DFPDSP_USE_ASM"
+fi
+
+arduino-cli compile \
+  --fqbn arduino:avr:uno \
+  --library "$ROOT" \
+  --build-path "$BUILD" \
+  --build-property "compiler.cpp.extra_flags=$FLAGS" \
+  --build-property "compiler.S.extra_flags=$FLAGS" \
+  "$ROOT/examples/Benchmark"
+
+# The sketch sleeps with interrupts off when done, which ends the simulation
+simavr -m atmega328p -f $F_CPU "$BUILD/Benchmark.ino.elf"
@@ -0,0 +1,303 @@
+/**
+ * @file    frame.cpp
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Compact binary framing for streaming samples and spectra over Serial.
+ *
+ */
+
+/* Includes ******************************************************************/
+#include "frame.h"
+
+#include <string.h>
+
+/* Defines *******************************************************************/
+// RFC 1055 SLIP special characters
+#define SLIP_END     0xC0
+#define SLIP_ESC     0xDB
+#define SLIP_ESC_END 0xDC
+#define SLIP_ESC_ESC 0xDD
+
+#define FRAME_HEADER 4
+#define FRAME_CRC    2
+
+/* Types *********************************************************************/
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+/**
+ * CRC-16/CCITT byte update without a table.
+ */
+static uint16_t crc16( uint16_t crc, uint8_t byte )
+{
+  uint8_t x = (crc >> 8) ^ byte;
+  x ^= x >> 4;
+  return (crc << 8) ^ ((uint16_t)x << 12) ^ ((uint16_t)x << 5) ^ x;
+}
+
+/**
+ * Writes one byte with SLIP escaping.
+ */
+static void writeEscaped( FrameEncoder* enc, uint8_t byte )
+{
+  if( byte == SLIP_END )
+  {
+    enc->write( SLIP_ESC );
+    byte = SLIP_ESC_END;
+  }
+  else if( byte == SLIP_ESC )
+  {
+    enc->write( SLIP_ESC );
+    byte = SLIP_ESC_ESC;
+  }
+  enc->write( byte );
+}
+
+/**
+ * Writes one byte of frame content, adding it to the CRC.
+ */
+static void put( FrameEncoder* enc, uint8_t byte )
+{
+  enc->crc = crc16( enc->crc, byte );
+  writeEscaped( enc, byte );
+}
+
+static void begin( FrameEncoder* enc, uint8_t type, int count )
+{
+  // A leading END flushes any line noise at the receiver
+  enc->write( SLIP_END );
+  enc->crc = 0xFFFF;
+  put( enc, type );
+  put( enc, enc->sequence );
+  put( enc, count & 0xFF );
+  put( enc, count >> 8 );
+
+  type &= ~FRAME_DELTA;
+  if( type < FRAME_REFERENCES )
+  {
+    enc->refs[type] = enc->sequence;
+  }
+}
+
+static uint8_t end( FrameEncoder* enc )
+{
+  uint16_t crc = enc->crc;
+  writeEscaped( enc, crc >> 8 );
+  writeEscaped( enc, crc & 0xFF );
+  enc->write( SLIP_END );
+  return enc->sequence++;
+}
+
+void FrameEncoder_init( FrameEncoder* enc, FrameWriter write )
+{
+  enc->write = write;
+  enc->crc = 0xFFFF;
+  enc->sequence = 0;
+  memset( enc->refs, 0, sizeof(enc->refs) );
+}
+
+uint8_t FrameEncoder_write( FrameEncoder* enc, uint8_t type, const Q_15* buf, int count )
+{
+  begin( enc, type & ~FRAME_DELTA, count );
+  for( int i = 0; i < count; ++i )
+  {
+    uint16_t value = buf[i];
+    put( enc, value & 0xFF );
+    put( enc, value >> 8 );
+  }
+  return end( enc );
+}
+
+uint8_t FrameEncoder_writeDelta( FrameEncoder* enc, uint8_t type, const Q_15* buf, const Q_15* prev, int count )
+{
+  type &= ~FRAME_DELTA;
+  if( type >= FRAME_REFERENCES )
+  {
+    return FrameEncoder_write( enc, type, buf, count );
+  }
+
+  uint8_t reference = enc->refs[type];
+  begin( enc, type | FRAME_DELTA, count );
+  put( enc, reference );
+  for( int i = 0; i < count; ++i )
+  {
+    // wrapping difference, zigzag so small negatives stay small
+    int16_t delta = (uint16_t)buf[i] - (uint16_t)prev[i];
+    uint16_t zigzag = ((uint16_t)delta << 1) ^ (uint16_t)(delta >> 15);
+    while( zigzag >= 0x80 )
+    {
+      put( enc, (zigzag & 0x7F) | 0x80 );
+      zigzag >>= 7;
+    }
+    put( enc, zigzag );
+  }
+  return end( enc );
+}
+
+void FrameDecoder_init( FrameDecoder* dec )
+{
+  memset( dec, 0, sizeof(*dec) );
+}
+
+/**
+ * Parses the frame collected in dec->buf into dec->frame.
+ */
+static int parse( FrameDecoder* dec )
+{
+  const uint8_t* buf = dec->buf;
+  int length = dec->length;
+
+  if( length < FRAME_HEADER + FRAME_CRC )
+  {
+    return FRAME_ERR_FORMAT;
+  }
+
+  uint16_t crc = 0xFFFF;
+  for( int i = 0; i < length; ++i )
+  {
+    crc = crc16( crc, buf[i] );
+  }
+  if( crc != 0 )
+  {
+    return FRAME_ERR_CRC;
+  }
+
+  // The frame is intact so it counts for sequence tracking even if unusable
+  uint8_t sequence = buf[1];
+  if( dec->synced )
+  {
+    dec->lost += (uint8_t)(sequence - dec->sequence - 1);
+  }
+  dec->synced = true;
+  dec->sequence = sequence;
+
+  Frame* frame = &dec->frame;
+  uint8_t type = buf[0] & ~FRAME_DELTA;
+  uint16_t count = buf[2] | (buf[3] << 8);
+  int pos = FRAME_HEADER;
+  int end = length - FRAME_CRC;
+
+  if( count > FRAME_MAX_VALUES )
+  {
+    return FRAME_ERR_FORMAT;
+  }
+
+  FrameReference* ref = (type < FRAME_REFERENCES) ? &dec->refs[type] : NULL;
+
+  if( buf[0] & FRAME_DELTA )
+  {
+    if( !ref || pos >= end )
+    {
+      return FRAME_ERR_FORMAT;
+    }
+    uint8_t reference = buf[pos++];
+    if( !ref->valid || ref->sequence != reference || ref->count != count )
+    {
+      ref->valid = false;
+      return FRAME_ERR_REFERENCE;
+    }
+
+    for( int i = 0; i < count; ++i )
+    {
+      uint16_t zigzag = 0;
+      uint8_t shift = 0;
+      uint8_t byte;
+      do
+      {
+        if( pos >= end || shift > 14 )
+        {
+          return FRAME_ERR_FORMAT;
+        }
+        byte = buf[pos++];
+        zigzag |= (uint16_t)(byte & 0x7F) << shift;
+        shift += 7;
+      } while( byte & 0x80 );
+
+      uint16_t delta = (zigzag >> 1) ^ (uint16_t)-(zigzag & 1);
+      frame->values[i] = (uint16_t)ref->values[i] + delta;
+    }
+  }
+  else
+  {
+    if( end - pos < 2 * count )
+    {
+      return FRAME_ERR_FORMAT;
+    }
+    for( int i = 0; i < count; ++i, pos += 2 )
+    {
+      frame->values[i] = buf[pos] | (buf[pos + 1] << 8);
+    }
+  }
+
+  if( pos != end )
+  {
+    return FRAME_ERR_FORMAT;
+  }
+
+  frame->type = type;
+  frame->sequence = sequence;
+  frame->count = count;
+
+  if( ref )
+  {
+    memcpy( ref->values, frame->values, count * sizeof(Q_15) );
+    ref->count = count;
+    ref->sequence = sequence;
+    ref->valid = true;
+  }
+
+  ++dec->frames;
+  return FRAME_READY;
+}
+
+int FrameDecoder_push( FrameDecoder* dec, uint8_t byte )
+{
+  if( byte == SLIP_END )
+  {
+    if( dec->length == 0 && !dec->overflow )
+    {
+      // back to back END bytes delimit nothing
+      return FRAME_NONE;
+    }
+
+    int result = dec->overflow ? FRAME_ERR_OVERFLOW : parse( dec );
+    dec->length = 0;
+    dec->escape = false;
+    dec->overflow = false;
+    if( result < 0 )
+    {
+      ++dec->errors;
+    }
+    return result;
+  }
+
+  if( dec->escape )
+  {
+    dec->escape = false;
+    if( byte == SLIP_ESC_END )
+    {
+      byte = SLIP_END;
+    }
+    else if( byte == SLIP_ESC_ESC )
+    {
+      byte = SLIP_ESC;
+    }
+  }
+  else if( byte == SLIP_ESC )
+  {
+    dec->escape = true;
+    return FRAME_NONE;
+  }
+
+  if( dec->length < FRAME_MAX_BYTES )
+  {
+    dec->buf[dec->length++] = byte;
+  }
+  else
+  {
+    dec->overflow = true;
+  }
+  return FRAME_NONE;
+}
@@ -0,0 +1,170 @@
+/**
+ * @file    frame.h
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Compact binary framing for streaming samples and spectra over Serial.
+ *
+ * Each frame is SLIP (RFC 1055) delimited so a receiver can resynchronize on
+ * the next END byte after noise or a reset. The encoder streams bytes straight
+ * from the DSP buffers through a write callback, so no frame buffer is needed
+ * on the target.
+ *
+ *     | type | sequence | count lo | count hi | [reference] | payload | crc hi | crc lo |
+ *
+ *  - type is FRAME_SAMPLES, FRAME_SPECTRUM or an application value below 0x80,
+ *    with FRAME_DELTA set when the payload is delta coded.
+ *  - sequence increments for every frame so the receiver can count losses.
+ *  - count is the number of Q_15 values in the payload.
+ *  - reference, only in delta frames, is the sequence of the frame the deltas
+ *    apply to, which must be the previous frame of the same type.
+ *  - payload is count little endian Q_15 values, or for delta frames count
+ *    zigzag varints of the difference from the reference, one to three bytes
+ *    each. Consecutive spectra of a steady signal mostly take one byte a bin.
+ *  - crc is CRC-16/CCITT (0x1021, init 0xFFFF) over everything before it.
+ *
+ * The decoder is plain C with no Arduino dependencies so the same code can
+ * be built into host side tools.
+ *
+ *     void serialWrite( uint8_t byte ) { Serial.write( byte ); }
+ *
+ *     FrameEncoder_init( &enc, serialWrite );
+ *     FFT_magnitude( spectrum, samples, 7 );
+ *     if( keyframe )
+ *       FrameEncoder_write( &enc, FRAME_SPECTRUM, spectrum, 128 );
+ *     else
+ *       FrameEncoder_writeDelta( &enc, FRAME_SPECTRUM, spectrum, previous, 128 );
+ *
+ */
+#ifndef   FRAME_H
+#define   FRAME_H
+
+/* Includes ******************************************************************/
+#include <inttypes.h>
+#include "DSP.h"
+
+/* Defines *******************************************************************/
+#define FRAME_SAMPLES  0x01
+#define FRAME_SPECTRUM 0x02
+#define FRAME_DELTA    0x80
+
+// Decoder limits, the encoder has none
+#ifndef FRAME_MAX_VALUES
+#define FRAME_MAX_VALUES 512
+#endif
+// Types below this can be delta coded
+#define FRAME_REFERENCES 4
+
+// Worst case frame size before SLIP escaping
+#define FRAME_MAX_BYTES (5 + 3 * FRAME_MAX_VALUES + 2)
+
+// FrameDecoder_push results
+#define FRAME_NONE           0
+#define FRAME_READY          1
+#define FRAME_ERR_CRC       -1
+#define FRAME_ERR_OVERFLOW  -2
+#define FRAME_ERR_FORMAT    -3
+#define FRAME_ERR_REFERENCE -4
+
+/* Types *********************************************************************/
+typedef void (*FrameWriter)( uint8_t byte );
+
+typedef struct FrameEncoder
+{
+  FrameWriter write;
+  uint16_t    crc;
+  uint8_t     sequence;
+  uint8_t     refs[FRAME_REFERENCES]; ///< last sequence sent of each type
+} FrameEncoder;
+
+typedef struct Frame
+{
+  uint8_t  type;     ///< without FRAME_DELTA
+  uint8_t  sequence;
+  uint16_t count;
+  Q_15     values[FRAME_MAX_VALUES];
+} Frame;
+
+typedef struct FrameReference
+{
+  Q_15     values[FRAME_MAX_VALUES];
+  uint16_t count;
+  uint8_t  sequence;
+  bool     valid;
+} FrameReference;
+
+typedef struct FrameDecoder
+{
+  uint8_t  buf[FRAME_MAX_BYTES];
+  uint16_t length;
+  bool     escape;
+  bool     overflow;
+
+  Frame          frame;   ///< the last decoded frame
+  FrameReference refs[FRAME_REFERENCES];
+
+  bool     synced;
+  uint8_t  sequence;
+  uint32_t frames;        ///< frames decoded
+  uint32_t lost;          ///< frames missing from the sequence
+  uint32_t errors;        ///< frames discarded
+} FrameDecoder;
+
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+/**
+ * Initializes a FrameEncoder
+ *
+ * @param enc the FrameEncoder to initialize
+ * @param write called for every byte of output, e.g. a wrapper on Serial.write
+ */
+void FrameEncoder_init( FrameEncoder* enc, FrameWriter write );
+
+/**
+ * Writes a frame of raw values.
+ *
+ * @param enc the FrameEncoder
+ * @param type FRAME_SAMPLES, FRAME_SPECTRUM or an application type
+ * @param buf the values to send
+ * @param count the number of values in buf
+ * @return the sequence number of the frame
+ */
+uint8_t FrameEncoder_write( FrameEncoder* enc, uint8_t type, const Q_15* buf, int count );
+
+/**
+ * Writes a frame delta coded against the previous frame of the same type,
+ * which must have had the same count. The receiver discards delta frames
+ * whose reference it missed, so send a full frame every so often. Types that
+ * can not be delta coded are sent as full frames.
+ *
+ * @param enc the FrameEncoder
+ * @param type FRAME_SAMPLES, FRAME_SPECTRUM or an application type below
+ *             FRAME_REFERENCES
+ * @param buf the values to send
+ * @param prev the values sent in the previous frame of this type
+ * @param count the number of values in buf
+ * @return the sequence number of the frame
+ */
+uint8_t FrameEncoder_writeDelta( FrameEncoder* enc, uint8_t type, const Q_15* buf, const Q_15* prev, int count );
+
+/**
+ * Initializes a FrameDecoder
+ *
+ * @param dec the FrameDecoder to initialize
+ */
+void FrameDecoder_init( FrameDecoder* dec );
+
+/**
+ * Feeds one received byte to the decoder. When a complete frame has been
+ * decoded it is available in dec->frame until the next call.
+ *
+ * @param dec the FrameDecoder
+ * @param byte the received byte
+ * @return FRAME_READY when a frame was decoded, FRAME_NONE while one is in
+ *         progress, or a negative FRAME_ERR_* code when a frame was discarded
+ */
+int FrameDecoder_push( FrameDecoder* dec, uint8_t byte );
+
+#endif // FRAME_H
@@ -0,0 +1,301 @@
+/**
+ * @file    g711.cpp
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * G.711 mu-law and A-law companding.
+ *
+ */
+
+/* Includes ******************************************************************/
+#include "g711.h"
+
+#include <Arduino.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* Defines *******************************************************************/
+#define MULAW_BIAS 0x21
+#define MULAW_CLIP 8158
+
+/* Types *********************************************************************/
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+
+/**
+ *  mu-law byte to 16 bit linear.
+ */
+const PROGMEM int16_t MULAW_DECODE_TABLE[256] =
+{
+   -32124,  -31100,  -30076,  -29052,  -28028,  -27004,  -25980,  -24956,
+   -23932,  -22908,  -21884,  -20860,  -19836,  -18812,  -17788,  -16764,
+   -15996,  -15484,  -14972,  -14460,  -13948,  -13436,  -12924,  -12412,
+   -11900,  -11388,  -10876,  -10364,   -9852,   -9340,   -8828,   -8316,
+    -7932,   -7676,   -7420,   -7164,   -6908,   -6652,   -6396,   -6140,
+    -5884,   -5628,   -5372,   -5116,   -4860,   -4604,   -4348,   -4092,
+    -3900,   -3772,   -3644,   -3516,   -3388,   -3260,   -3132,   -3004,
+    -2876,   -2748,   -2620,   -2492,   -2364,   -2236,   -2108,   -1980,
+    -1884,   -1820,   -1756,   -1692,   -1628,   -1564,   -1500,   -1436,
+    -1372,   -1308,   -1244,   -1180,   -1116,   -1052,    -988,    -924,
+     -876,    -844,    -812,    -780,    -748,    -716,    -684,    -652,
+     -620,    -588,    -556,    -524,    -492,    -460,    -428,    -396,
+     -372,    -356,    -340,    -324,    -308,    -292,    -276,    -260,
+     -244,    -228,    -212,    -196,    -180,    -164,    -148,    -132,
+     -120,    -112,    -104,     -96,     -88,     -80,     -72,     -64,
+      -56,     -48,     -40,     -32,     -24,     -16,      -8,       0,
+    32124,   31100,   30076,   29052,   28028,   27004,   25980,   24956,
+    23932,   22908,   21884,   20860,   19836,   18812,   17788,   16764,
+    15996,   15484,   14972,   14460,   13948,   13436,   12924,   12412,
+    11900,   11388,   10876,   10364,    9852,    9340,    8828,    8316,
+     7932,    7676,    7420,    7164,    6908,    6652,    6396,    6140,
+     5884,    5628,    5372,    5116,    4860,    4604,    4348,    4092,
+     3900,    3772,    3644,    3516,    3388,    3260,    3132,    3004,
+     2876,    2748,    2620,    2492,    2364,    2236,    2108,    1980,
+     1884,    1820,    1756,    1692,    1628,    1564,    1500,    1436,
+     1372,    1308,    1244,    1180,    1116,    1052,     988,     924,
+      876,     844,     812,     780,     748,     716,     684,     652,
+      620,     588,     556,     524,     492,     460,     428,     396,
+      372,     356,     340,     324,     308,     292,     276,     260,
+      244,     228,     212,     196,     180,     164,     148,     132,
+      120,     112,     104,      96,      88,      80,      72,      64,
+       56,      48,      40,      32,      24,      16,       8,       0,
+};
+
+/**
+ *  A-law byte to 16 bit linear.
+ */
+const PROGMEM int16_t ALAW_DECODE_TABLE[256] =
+{
+    -5504,   -5248,   -6016,   -5760,   -4480,   -4224,   -4992,   -4736,
+    -7552,   -7296,   -8064,   -7808,   -6528,   -6272,   -7040,   -6784,
+    -2752,   -2624,   -3008,   -2880,   -2240,   -2112,   -2496,   -2368,
+    -3776,   -3648,   -4032,   -3904,   -3264,   -3136,   -3520,   -3392,
+   -22016,  -20992,  -24064,  -23040,  -17920,  -16896,  -19968,  -18944,
+   -30208,  -29184,  -32256,  -31232,  -26112,  -25088,  -28160,  -27136,
+   -11008,  -10496,  -12032,  -11520,   -8960,   -8448,   -9984,   -9472,
+   -15104,  -14592,  -16128,  -15616,  -13056,  -12544,  -14080,  -13568,
+     -344,    -328,    -376,    -360,    -280,    -264,    -312,    -296,
+     -472,    -456,    -504,    -488,    -408,    -392,    -440,    -424,
+      -88,     -72,    -120,    -104,     -24,      -8,     -56,     -40,
+     -216,    -200,    -248,    -232,    -152,    -136,    -184,    -168,
+    -1376,   -1312,   -1504,   -1440,   -1120,   -1056,   -1248,   -1184,
+    -1888,   -1824,   -2016,   -1952,   -1632,   -1568,   -1760,   -1696,
+     -688,    -656,    -752,    -720,    -560,    -528,    -624,    -592,
+     -944,    -912,   -1008,    -976,    -816,    -784,    -880,    -848,
+     5504,    5248,    6016,    5760,    4480,    4224,    4992,    4736,
+     7552,    7296,    8064,    7808,    6528,    6272,    7040,    6784,
+     2752,    2624,    3008,    2880,    2240,    2112,    2496,    2368,
+     3776,    3648,    4032,    3904,    3264,    3136,    3520,    3392,
+    22016,   20992,   24064,   23040,   17920,   16896,   19968,   18944,
+    30208,   29184,   32256,   31232,   26112,   25088,   28160,   27136,
+    11008,   10496,   12032,   11520,    8960,    8448,    9984,    9472,
+    15104,   14592,   16128,   15616,   13056,   12544,   14080,   13568,
+      344,     328,     376,     360,     280,     264,     312,     296,
+      472,     456,     504,     488,     408,     392,     440,     424,
+       88,      72,     120,     104,      24,       8,      56,      40,
+      216,     200,     248,     232,     152,     136,     184,     168,
+     1376,    1312,    1504,    1440,    1120,    1056,    1248,    1184,
+     1888,    1824,    2016,    1952,    1632,    1568,    1760,    1696,
+      688,     656,     752,     720,     560,     528,     624,     592,
+      944,     912,    1008,     976,     816,     784,     880,     848,
+};
+
+/* Functions *****************************************************************/
+
+/**
+ * Number of significant bits in a value below 128, by binary search with
+ * compares rather than branches.
+ */
+static inline uint8_t bitLength7( uint8_t t )
+{
+  uint8_t n = (t > 0x0F) << 2;
+  t >>= n;
+  uint8_t s = (t > 0x03) << 1;
+  t >>= s;
+  return n + s + (t > 0) + (t > 1);
+}
+
+uint8_t MuLaw_encodeSample( Q_15 sample )
+{
+  int16_t sign = sample >> 15;
+
+  // mu-law works on 14 bits
+  uint16_t mag = (uint16_t)((sample >> 2) ^ sign) - sign;
+
+  // mag = min( mag, MULAW_CLIP )
+  int16_t over = mag - MULAW_CLIP;
+  mag -= over & ~(over >> 15);
+
+  uint16_t x = mag + MULAW_BIAS;
+  uint8_t exponent = bitLength7( x >> 6 );
+  uint8_t mantissa = (x >> (exponent + 1)) & 0x0F;
+
+  return ~((sign & 0x80) | (exponent << 4) | mantissa);
+}
+
+Q_15 MuLaw_decodeSample( uint8_t code )
+{
+  return pgm_read_word( &MULAW_DECODE_TABLE[code] );
+}
+
+uint8_t ALaw_encodeSample( Q_15 sample )
+{
+  int16_t sign = sample >> 15;
+
+  // ones complement magnitude in 12 bits
+  uint16_t mag = (uint16_t)(sample ^ sign) >> 3;
+  uint8_t segment = bitLength7( mag >> 5 );
+
+  // segments 0 and 1 share the same step
+  uint8_t mantissa = (mag >> (segment + !segment)) & 0x0F;
+
+  return ((segment << 4) | mantissa) ^ (0xD5 ^ (sign & 0x80));
+}
+
+Q_15 ALaw_decodeSample( uint8_t code )
+{
+  return pgm_read_word( &ALAW_DECODE_TABLE[code] );
+}
+
+#if defined(__SSE2__)
+
+/**
+ * Converts eight non-negative 16 bit values to float and returns the biased
+ * exponent and top four mantissa bits of each, (exponent << 4) | mantissa,
+ * which is the segment and step of a companded code.
+ */
+static inline __m128i floatSegments( __m128i x )
+{
+  __m128i zero = _mm_setzero_si128();
+  __m128i lo = _mm_castps_si128( _mm_cvtepi32_ps( _mm_unpacklo_epi16( x, zero ) ) );
+  __m128i hi = _mm_castps_si128( _mm_cvtepi32_ps( _mm_unpackhi_epi16( x, zero ) ) );
+  return _mm_packs_epi32( _mm_srli_epi32( lo, 19 ), _mm_srli_epi32( hi, 19 ) );
+}
+
+/**
+ * Computes value << shift for eight 16 bit lanes through the float exponent.
+ */
+static inline __m128i shiftLanes( __m128i value, __m128i shift )
+{
+  __m128i zero = _mm_setzero_si128();
+  __m128i lo = _mm_castps_si128( _mm_cvtepi32_ps( _mm_unpacklo_epi16( value, zero ) ) );
+  __m128i hi = _mm_castps_si128( _mm_cvtepi32_ps( _mm_unpackhi_epi16( value, zero ) ) );
+  lo = _mm_add_epi32( lo, _mm_slli_epi32( _mm_unpacklo_epi16( shift, zero ), 23 ) );
+  hi = _mm_add_epi32( hi, _mm_slli_epi32( _mm_unpackhi_epi16( shift, zero ), 23 ) );
+  return _mm_packs_epi32( _mm_cvttps_epi32( _mm_castsi128_ps( lo ) ),
+                          _mm_cvttps_epi32( _mm_castsi128_ps( hi ) ) );
+}
+
+static inline __m128i loadBytes( const uint8_t* src )
+{
+  return _mm_unpacklo_epi8( _mm_loadl_epi64( (const __m128i*)src ), _mm_setzero_si128() );
+}
+
+static inline void storeBytes( uint8_t* dst, __m128i code )
+{
+  _mm_storel_epi64( (__m128i*)dst, _mm_packus_epi16( code, code ) );
+}
+
+#endif
+
+void MuLaw_encode( uint8_t* dst, const Q_15* src, int count )
+{
+#if defined(__SSE2__)
+  for( ; count >= 8; count -= 8, src += 8, dst += 8 )
+  {
+    __m128i x = _mm_loadu_si128( (const __m128i*)src );
+    __m128i sign = _mm_srai_epi16( x, 15 );
+    __m128i mag = _mm_sub_epi16( _mm_xor_si128( _mm_srai_epi16( x, 2 ), sign ), sign );
+    mag = _mm_min_epi16( mag, _mm_set1_epi16( MULAW_CLIP ) );
+    mag = _mm_add_epi16( mag, _mm_set1_epi16( MULAW_BIAS ) );
+
+    // the float exponent is 127 + 5 + segment
+    __m128i code = _mm_sub_epi16( floatSegments( mag ), _mm_set1_epi16( (127 + 5) << 4 ) );
+    code = _mm_or_si128( code, _mm_and_si128( sign, _mm_set1_epi16( 0x80 ) ) );
+    storeBytes( dst, _mm_xor_si128( code, _mm_set1_epi16( 0xFF ) ) );
+  }
+#endif
+  while( count-- > 0 )
+  {
+    *dst++ = MuLaw_encodeSample( *src++ );
+  }
+}
+
+void MuLaw_decode( Q_15* dst, const uint8_t* src, int count )
+{
+#if defined(__SSE2__)
+  for( ; count >= 8; count -= 8, src += 8, dst += 8 )
+  {
+    __m128i u = _mm_xor_si128( loadBytes( src ), _mm_set1_epi16( 0xFF ) );
+    __m128i mantissa = _mm_and_si128( u, _mm_set1_epi16( 0x0F ) );
+    __m128i exponent = _mm_and_si128( _mm_srli_epi16( u, 4 ), _mm_set1_epi16( 0x07 ) );
+
+    // (((mantissa << 1) + MULAW_BIAS) << exponent) - MULAW_BIAS, scaled by 4
+    __m128i t = _mm_add_epi16( _mm_add_epi16( mantissa, mantissa ), _mm_set1_epi16( MULAW_BIAS ) );
+    t = shiftLanes( t, _mm_add_epi16( exponent, _mm_set1_epi16( 2 ) ) );
+    t = _mm_sub_epi16( t, _mm_set1_epi16( MULAW_BIAS << 2 ) );
+
+    __m128i sign = _mm_cmpgt_epi16( u, _mm_set1_epi16( 0x7F ) );
+    t = _mm_sub_epi16( _mm_xor_si128( t, sign ), sign );
+    _mm_storeu_si128( (__m128i*)dst, t );
+  }
+#endif
+  while( count-- > 0 )
+  {
+    *dst++ = MuLaw_decodeSample( *src++ );
+  }
+}
+
+void ALaw_encode( uint8_t* dst, const Q_15* src, int count )
+{
+#if defined(__SSE2__)
+  for( ; count >= 8; count -= 8, src += 8, dst += 8 )
+  {
+    __m128i x = _mm_loadu_si128( (const __m128i*)src );
+    __m128i sign = _mm_srai_epi16( x, 15 );
+    __m128i mag = _mm_srli_epi16( _mm_xor_si128( x, sign ), 3 );
+
+    // the float exponent is 127 + 4 + segment, except in the linear segment
+    __m128i code = _mm_sub_epi16( floatSegments( mag ), _mm_set1_epi16( (127 + 4) << 4 ) );
+    __m128i linear = _mm_cmplt_epi16( mag, _mm_set1_epi16( 32 ) );
+    code = _mm_or_si128( _mm_andnot_si128( linear, code ),
+                         _mm_and_si128( linear, _mm_srli_epi16( mag, 1 ) ) );
+
+    __m128i mask = _mm_xor_si128( _mm_set1_epi16( 0xD5 ), _mm_and_si128( sign, _mm_set1_epi16( 0x80 ) ) );
+    storeBytes( dst, _mm_xor_si128( code, mask ) );
+  }
+#endif
+  while( count-- > 0 )
+  {
+    *dst++ = ALaw_encodeSample( *src++ );
+  }
+}
+
+void ALaw_decode( Q_15* dst, const uint8_t* src, int count )
+{
+#if defined(__SSE2__)
+  for( ; count >= 8; count -= 8, src += 8, dst += 8 )
+  {
+    __m128i a = _mm_xor_si128( loadBytes( src ), _mm_set1_epi16( 0x55 ) );
+    __m128i mantissa = _mm_and_si128( a, _mm_set1_epi16( 0x0F ) );
+    __m128i segment = _mm_and_si128( _mm_srli_epi16( a, 4 ), _mm_set1_epi16( 0x07 ) );
+
+    // segment 0 is ((mantissa << 4) + 8), others ((mantissa << 4) + 0x108) << (segment - 1)
+    __m128i logarithmic = _mm_cmpgt_epi16( segment, _mm_setzero_si128() );
+    __m128i t = _mm_add_epi16( _mm_add_epi16( mantissa, mantissa ), _mm_set1_epi16( 1 ) );
+    t = _mm_add_epi16( t, _mm_and_si128( logarithmic, _mm_set1_epi16( 32 ) ) );
+    __m128i shift = _mm_add_epi16( _mm_add_epi16( segment, _mm_set1_epi16( 3 ) ), logarithmic );
+    t = shiftLanes( t, shift );
+
+    __m128i negative = _mm_cmplt_epi16( a, _mm_set1_epi16( 0x80 ) );
+    t = _mm_sub_epi16( _mm_xor_si128( t, negative ), negative );
+    _mm_storeu_si128( (__m128i*)dst, t );
+  }
+#endif
+  while( count-- > 0 )
+  {
+    *dst++ = ALaw_decodeSample( *src++ );
+  }
+}
@@ -0,0 +1,97 @@
+/**
+ * @file    g711.h
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * G.711 mu-law and A-law companding, 8 bits per sample for 2:1 compression
+ * of Q_15 audio.
+ *
+ * Encoding is branch free, finding the segment with a fixed sequence of
+ * compares and shifts. Decoding is a lookup in a 256 entry PROGMEM table.
+ * Q_15 samples are treated as 16 bit linear PCM, so the results match the
+ * usual reference codecs. On hosts with SSE2 the block functions process
+ * eight samples at a time and produce identical bytes.
+ *
+ */
+#ifndef   G711_H
+#define   G711_H
+
+/* Includes ******************************************************************/
+#include <inttypes.h>
+#include "DSP.h"
+
+/* Defines *******************************************************************/
+/* Types *********************************************************************/
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+/**
+ * Encodes one sample as mu-law.
+ *
+ * @param sample the sample to encode
+ * @return the mu-law byte
+ */
+uint8_t MuLaw_encodeSample( Q_15 sample );
+
+/**
+ * Decodes one mu-law byte.
+ *
+ * @param code the mu-law byte
+ * @return the reconstructed sample
+ */
+Q_15 MuLaw_decodeSample( uint8_t code );
+
+/**
+ * Encodes a block of samples as mu-law.
+ *
+ * @param dst where to write count bytes
+ * @param src the samples to encode
+ * @param count the number of samples in src
+ */
+void MuLaw_encode( uint8_t* dst, const Q_15* src, int count );
+
+/**
+ * Decodes a block of mu-law bytes.
+ *
+ * @param dst where to write count samples
+ * @param src the mu-law bytes
+ * @param count the number of bytes in src
+ */
+void MuLaw_decode( Q_15* dst, const uint8_t* src, int count );
+
+/**
+ * Encodes one sample as A-law.
+ *
+ * @param sample the sample to encode
+ * @return the A-law byte
+ */
+uint8_t ALaw_encodeSample( Q_15 sample );
+
+/**
+ * Decodes one A-law byte.
+ *
+ * @param code the A-law byte
+ * @return the reconstructed sample
+ */
+Q_15 ALaw_decodeSample( uint8_t code );
+
+/**
+ * Encodes a block of samples as A-law.
+ *
+ * @param dst where to write count bytes
+ * @param src the samples to encode
+ * @param count the number of samples in src
+ */
+void ALaw_encode( uint8_t* dst, const Q_15* src, int count );
+
+/**
+ * Decodes a block of A-law bytes.
+ *
+ * @param dst where to write count samples
+ * @param src the A-law bytes
+ * @param count the number of bytes in src
+ */
+void ALaw_decode( Q_15* dst, const uint8_t* src, int count );
+
+#endif // G711_H
@@ -0,0 +1,106 @@
+/**
+ * @file    linecode.cpp
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Streaming NRZ and Manchester line code decoder.
+ *
+ */
+
+/* Includes ******************************************************************/
+#include "linecode.h"
+
+#include <Arduino.h>
+
+/* Defines *******************************************************************/
+// One sample in UQ8_8
+#define LINECODE_SAMPLE 0x100
+
+/* Types *********************************************************************/
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+void LineDecoder_init( LineDecoder* ld, LineCode code, uint16_t samplesPerBitQ8, Q_15 center, Q_15 hysteresis )
+{
+  // Going high needs the upper threshold, going low the lower
+  ld->threshold[0] = center + hysteresis;
+  ld->threshold[1] = center - hysteresis;
+  ld->period = (LINECODE_NRZ == code) ? samplesPerBitQ8 : (samplesPerBitQ8 >> 1);
+  ld->phase = 0;
+  ld->level = 0;
+  ld->firstHalf = 0;
+  ld->inPair = 0;
+  ld->code = code;
+}
+
+int LineDecoder_process( LineDecoder* ld, const Q_15* buf, int count, uint8_t* bits, int maxBits, int* consumed )
+{
+  const Q_15* start = buf;
+  const uint16_t period = ld->period;
+  const uint16_t mid = period >> 1;
+  // Manchester IEEE takes the second half as the bit, Thomas the first
+  const uint8_t invert = (LINECODE_MANCHESTER_THOMAS == ld->code) ? 1 : 0;
+  int n = 0;
+
+  // Check for room first so a full bits doesn't eat a sample
+  while( n < maxBits && count-- )
+  {
+    uint8_t level = (*buf++ > ld->threshold[ld->level]);
+    uint8_t edge = level ^ ld->level;
+    ld->level = level;
+
+    // An edge belongs at phase 0, pull halfway toward it
+    if( edge )
+    {
+      int16_t err = (ld->phase < mid) ? (int16_t)ld->phase : (int16_t)ld->phase - (int16_t)period;
+      ld->phase -= err >> 1;
+    }
+
+    uint16_t before = ld->phase;
+    ld->phase += LINECODE_SAMPLE;
+    if( ld->phase >= period )
+    {
+      ld->phase -= period;
+    }
+
+    // Slice when the phase passes the middle of the cell
+    if( (before < mid) == (ld->phase < mid) || ld->phase < before )
+    {
+      continue;
+    }
+
+    uint8_t bit;
+    if( LINECODE_NRZ == ld->code )
+    {
+      bit = level;
+    }
+    else if( !ld->inPair )
+    {
+      ld->firstHalf = level;
+      ld->inPair = 1;
+      continue;
+    }
+    else if( level == ld->firstHalf )
+    {
+      // No mid bit transition, the pairing is a cell off so slip a cell
+      ld->firstHalf = level;
+      continue;
+    }
+    else
+    {
+      ld->inPair = 0;
+      bit = level ^ invert;
+    }
+
+    uint8_t mask = 0x80 >> (n & 7);
+    bits[n >> 3] = (bits[n >> 3] & ~mask) | (bit ? mask : 0);
+    ++n;
+  }
+
+  if( consumed )
+  {
+    *consumed = buf - start;
+  }
+  return n;
+}
@@ -0,0 +1,86 @@
+/**
+ * @file    linecode.h
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Streaming NRZ and Manchester line code decoder for digital signals sampled
+ * through the ADC.
+ *
+ *  hysteresis slicer -> edge driven DPLL clock recovery -> cell slicing
+ *                    -> Manchester pairing (or NRZ bits)
+ *
+ * The signal is split into cells, one per bit for NRZ and two per bit for
+ * Manchester. A phase accumulator runs one cell per period and is pulled
+ * halfway toward each edge, and the slicer level is taken at the middle of
+ * each cell. Manchester cell pairs that don't differ mean the pairing is off
+ * by a cell, so one cell is slipped to resynchronize.
+ *
+ *     uint8_t bytes[8];
+ *     while( SampleBuffer_popAllOrNothing( &sb, buf, 64 ) )
+ *     {
+ *       for( int used, done = 0; done < 64; done += used )
+ *       {
+ *         int n = LineDecoder_process( &ld, buf + done, 64 - done, bytes, 64, &used );
+ *         ...
+ *       }
+ *     }
+ *
+ */
+#ifndef   LINECODE_H
+#define   LINECODE_H
+
+/* Includes ******************************************************************/
+#include <inttypes.h>
+#include "DSP.h"
+
+/* Defines *******************************************************************/
+
+/* Types *********************************************************************/
+typedef enum LineCode
+{
+  LINECODE_NRZ,              ///< high is 1
+  LINECODE_MANCHESTER_IEEE,  ///< low to high is 1 (IEEE 802.3)
+  LINECODE_MANCHESTER_THOMAS,///< high to low is 1 (G.E. Thomas)
+} LineCode;
+
+typedef struct LineDecoder
+{
+  Q_15     threshold[2]; ///< slicer thresholds, indexed by the current level
+  uint16_t period;       ///< samples per cell, UQ8_8
+  uint16_t phase;        ///< position in the current cell, UQ8_8
+  uint8_t  level;        ///< slicer output
+  uint8_t  firstHalf;    ///< first cell of a Manchester pair
+  uint8_t  inPair;       ///< 1 when the next cell completes a pair
+  uint8_t  code;
+} LineDecoder;
+
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+/**
+ * Initializes a LineDecoder
+ *
+ * @param ld the LineDecoder to initialize
+ * @param code the line code
+ * @param samplesPerBitQ8 the nominal bit length in samples, UQ8_8. Cells need at least 2 samples.
+ * @param center the slicer decision level
+ * @param hysteresis the slicer switches at center +/- hysteresis
+ */
+void LineDecoder_init( LineDecoder* ld, LineCode code, uint16_t samplesPerBitQ8, Q_15 center, Q_15 hysteresis );
+
+/**
+ * Decodes a block of samples.
+ *
+ * @param ld the LineDecoder
+ * @param buf the samples
+ * @param count the number of samples in buf
+ * @param bits where to pack the decoded bits, MSB first
+ * @param maxBits the room in bits, decoding stops when it is full
+ * @param consumed if not NULL, set to the number of samples used. It is less
+ *        than count when bits fills, and the rest of buf should be passed again.
+ * @return the number of bits decoded
+ */
+int LineDecoder_process( LineDecoder* ld, const Q_15* buf, int count, uint8_t* bits, int maxBits, int* consumed );
+
+#endif // LINECODE_H
@@ -0,0 +1,169 @@
+/**
+ * @file    lpc.cpp
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Linear Prediction Coefficients (LPC) via fixed point Levinson-Durbin.
+ *
+ */
+
+/* Includes ******************************************************************/
+#include "lpc.h"
+
+#include <Arduino.h>
+
+/* Defines *******************************************************************/
+// Prediction coefficients are kept as Q4_27 during the recursion
+#define Q27_SHIFT 27
+
+/* Types *********************************************************************/
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+/**
+ * Sums the lag k products of x, each shifted right by shift.
+ */
+static int32_t lagSum( const Q_15* x, int n, int k, int shift )
+{
+  int32_t sum = 0;
+  const Q_15* y = x + k;
+  for( int i=k; i<n; ++i)
+  {
+    sum += ((int32_t)*x++ * *y++) >> shift;
+  }
+  return sum;
+}
+
+void LPC_autocorrelation( int32_t* r, const Q_15* x, int n, int order )
+{
+  // Each product is < 2^30, so n of them are safe with a shift of log2(n)
+  int safe = 0;
+  while( (1 << safe) < n )
+  {
+    ++safe;
+  }
+
+  // Use the energy to find how much of that shift this frame really needs
+  int32_t energy = lagSum( x, n, 0, safe );
+  int headroom = 0;
+  while( headroom < safe && energy < 0x20000000L )
+  {
+    energy <<= 1;
+    ++headroom;
+  }
+  int shift = safe - headroom;
+
+  // Normalize so r[0] is in [2^30..2^31)
+  int32_t r0 = lagSum( x, n, 0, shift );
+  int norm = 0;
+  if( 0 == r0 )
+  {
+    r0 = 1;
+  }
+  while( r0 < 0x40000000L )
+  {
+    r0 <<= 1;
+    ++norm;
+  }
+  r[0] = r0;
+
+  for( int k=1; k<=order; ++k)
+  {
+    r[k] = (k < n) ? (lagSum( x, n, k, shift ) << norm) : 0;
+  }
+}
+
+int LPC_levinson( Q3_12* a, Q_15* k, const int32_t* r, int order )
+{
+  int32_t rs[LPC_MAX_ORDER + 1];
+  int32_t acoef[LPC_MAX_ORDER + 1];
+  int32_t prev[LPC_MAX_ORDER + 1];
+
+  order = constrain( order, 0, LPC_MAX_ORDER );
+  for( int j=0; j<=order; ++j)
+  {
+    // Halve r for headroom, adding the white noise correction of 1/8192 to r[0]
+    rs[j] = r[j] >> 1;
+    acoef[j] = 0;
+    a[j] = 0;
+    if( k && j < order )
+    {
+      k[j] = 0;
+    }
+  }
+  rs[0] += r[0] >> 14;
+  acoef[0] = 1L << Q27_SHIFT;
+  a[0] = Q12_ONE;
+
+  int32_t error = rs[0];
+  if( error <= 0 )
+  {
+    return 0;
+  }
+
+  for( int i=1; i<=order; ++i)
+  {
+    // acc = sum( a[j]*r[i-j] ), j=0..i-1
+    int64_t acc = (int64_t)rs[i] << Q27_SHIFT;
+    for( int j=1; j<i; ++j)
+    {
+      acc += (int64_t)acoef[j] * rs[i - j];
+    }
+    acc >>= Q27_SHIFT;
+
+    // A reflection coefficient of magnitude 1 or more is unstable
+    if( acc >= error || -acc >= error )
+    {
+      return i - 1;
+    }
+    int32_t refl = (int32_t)(-(acc << 31) / error); // Q_31
+
+    for( int j=1; j<i; ++j)
+    {
+      prev[j] = acoef[j];
+    }
+    for( int j=1; j<i; ++j)
+    {
+      acoef[j] = prev[j] + (int32_t)(((int64_t)refl * prev[i - j]) >> 31);
+    }
+    acoef[i] = refl >> (31 - Q27_SHIFT);
+
+    // Stop before a coefficient overflows the Q3_12 output
+    for( int j=1; j<=i; ++j)
+    {
+      if( acoef[j] >= (8L << Q27_SHIFT) || acoef[j] < -(8L << Q27_SHIFT) )
+      {
+        return i - 1;
+      }
+    }
+
+    // error *= 1 - refl^2
+    int32_t refl2 = (int32_t)(((int64_t)refl * refl) >> 31);
+    error -= (int32_t)(((int64_t)error * refl2) >> 31);
+    if( error <= 0 )
+    {
+      return i - 1;
+    }
+
+    for( int j=1; j<=i; ++j)
+    {
+      a[j] = (Q3_12)((acoef[j] + (1L << (Q27_SHIFT - 13))) >> (Q27_SHIFT - 12));
+    }
+    if( k )
+    {
+      k[i - 1] = (Q_15)(refl >> 16);
+    }
+  }
+
+  return order;
+}
+
+int LPC_analyze( Q3_12* a, Q_15* k, const Q_15* x, int n, int order )
+{
+  int32_t r[LPC_MAX_ORDER + 1];
+
+  order = constrain( order, 0, LPC_MAX_ORDER );
+  LPC_autocorrelation( r, x, n, order );
+  return LPC_levinson( a, k, r, order );
+}
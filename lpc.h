@@ -0,0 +1,79 @@
+/**
+ * @file    lpc.h
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Linear Prediction Coefficients (LPC) for speech coding and formant tracking.
+ *
+ *  x[n] ~= -sum( a[j]*x[n-j] ), j=1..order
+ *  A(z) = 1 + a[1]z^-1 + ... + a[order]z^-order
+ *
+ */
+#ifndef   LPC_H
+#define   LPC_H
+
+/* Includes ******************************************************************/
+#include <inttypes.h>
+#include "DSP.h"
+
+/* Defines *******************************************************************/
+#define LPC_MAX_ORDER 16
+
+// 1.0 in Q3_12
+#define Q12_ONE 0x1000
+
+/* Types *********************************************************************/
+
+/**
+ *  Q3_12 is a 16 bit fixed point quantity representing numbers on the range [-8..8) at a step of 1/4096.
+ *  Used for prediction coefficients which commonly exceed 1.
+ */
+typedef int16_t Q3_12;
+
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+/**
+ * Calculates the autocorrelation of a frame, r[k] = sum( x[n]*x[n+k] ).
+ * Products are accumulated in 32 bits with just enough right shift to be
+ * safe from overflow for the energy of this frame, then the result is
+ * normalized so r[0] fills a Q_31.
+ *
+ * @param r where to write the order+1 autocorrelation values
+ * @param x the frame, already windowed if desired
+ * @param n the number of samples in x
+ * @param order the highest lag to calculate
+ */
+void LPC_autocorrelation( int32_t* r, const Q_15* x, int n, int order );
+
+/**
+ * Converts an autocorrelation into prediction and reflection coefficients
+ * with the Levinson-Durbin recursion. A -40 dB white noise floor is added to
+ * r[0] to keep the recursion well conditioned.
+ *
+ * The recursion stops early if a reflection coefficient reaches 1 (an unstable
+ * filter), the prediction error stops being positive or a coefficient leaves
+ * the Q3_12 range. Coefficients past the returned order are left at zero.
+ *
+ * @param a where to write the order+1 prediction coefficients, a[0] = 1
+ * @param k where to write the order reflection coefficients, may be NULL
+ * @param r the order+1 autocorrelation values
+ * @param order the order of the predictor, at most LPC_MAX_ORDER
+ * @return the order reached, equal to order if the filter is stable
+ */
+int LPC_levinson( Q3_12* a, Q_15* k, const int32_t* r, int order );
+
+/**
+ * Calculates the prediction and reflection coefficients of a frame.
+ *
+ * @param a where to write the order+1 prediction coefficients, a[0] = 1
+ * @param k where to write the order reflection coefficients, may be NULL
+ * @param x the frame, already windowed if desired
+ * @param n the number of samples in x
+ * @param order the order of the predictor, at most LPC_MAX_ORDER
+ * @return the order reached, equal to order if the filter is stable
+ */
+int LPC_analyze( Q3_12* a, Q_15* k, const Q_15* x, int n, int order );
+
+#endif // LPC_H
@@ -0,0 +1,176 @@
+/**
+ * @file    measurement.cpp
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Audio path quality measurements (THD, SNR, SINAD and ENOB) made from a
+ * single spectrum of a captured test tone.
+ *
+ */
+
+/* Includes ******************************************************************/
+#include "measurement.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+/* Defines *******************************************************************/
+// hex(1.76*0x8000+0.5) dB lost to quantization of a full scale sine
+#define SINAD_OFFSET_1_76 0xE148
+// hex(0x8000/6.02+0.5) bits per dB
+#define BITS_PER_DB       0x1543
+
+// 4 term Blackman-Harris coefficients, Q_15
+#define BLACKMAN_HARRIS_A0 11756 // 0.35875
+#define BLACKMAN_HARRIS_A1 16000 // 0.48829
+#define BLACKMAN_HARRIS_A2  4629 // 0.14128
+#define BLACKMAN_HARRIS_A3   383 // 0.01168
+
+/* Types *********************************************************************/
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+// Bins either side of a tone's center holding its power, by AudioQualityWindow.
+// Off bin the peak can be half a bin from the center, so one more than the
+// main lobe.
+static const int8_t LOBES[] = { 1, 2, 5 };
+
+/* Functions *****************************************************************/
+
+/**
+ * Applies a 4 term Blackman-Harris window in place. Its sidelobes are 92dB
+ * down, against 31dB for Hann, so a tone that falls between bins does not
+ * leak into the noise, at the cost of a main lobe of +/-4 bins.
+ *
+ * @param buf the samples to window
+ * @param order the order of magnitude of the block. size = 2^order.
+ */
+static void windowBlackmanHarris( Q_15* buf, int order )
+{
+  const int N=1<<order;
+  const BAM8 dAngle=(1<<(8-order));
+  BAM8 angle=0;
+  for( int i=0; i<N; ++i)
+  {
+    int32_t w = ((int32_t)BLACKMAN_HARRIS_A0 << 15)
+              - (int32_t)BLACKMAN_HARRIS_A1 * cosine_table( angle )
+              + (int32_t)BLACKMAN_HARRIS_A2 * cosine_table( (BAM8)(angle * 2) )
+              - (int32_t)BLACKMAN_HARRIS_A3 * cosine_table( (BAM8)(angle * 3) );
+    w = (w + (1L << 14)) >> 15;
+    buf[i] = Q15_mult( buf[i], (Q_15)min( w, (int32_t)Q15_ONE ) );
+    angle+=dAngle;
+  }
+}
+
+/**
+ * Sums the power of the bins within lobe of center and marks them as used so
+ * they are not counted again as noise or as another harmonic.
+ *
+ * @param mag the magnitude spectrum
+ * @param half the number of usable bins
+ * @param center the bin the tone is centered on
+ * @param lobe the number of bins either side of center holding the tone
+ * @param excluded incremented for each bin consumed
+ * @return the power of the tone
+ */
+static uint32_t takeTone( Q_15* mag, int half, int center, int lobe, int* excluded )
+{
+  uint32_t power = 0;
+  int first = max( center - lobe, 0 );
+  int last  = min( center + lobe, half - 1 );
+  for( int i=first; i<=last; ++i)
+  {
+    // Magnitudes are never negative, so -1 marks a used bin
+    if( mag[i] >= 0 )
+    {
+      power += (uint32_t)mag[i] * (uint32_t)mag[i];
+      mag[i] = -1;
+      ++(*excluded);
+    }
+  }
+  return power;
+}
+
+int AudioQuality_measure( AudioQuality* result, const Q_15* src, int order, int harmonics, AudioQualityWindow window )
+{
+  const int N=1<<order;
+  const int half=N>>1;
+  const int lobe=LOBES[window];
+  Q_15 windowed[N];
+  Q_15 mag[N];
+
+  memset( result, 0, sizeof(*result) );
+
+  if( AUDIO_QUALITY_RECTANGULAR != window )
+  {
+    memcpy( windowed, src, sizeof(windowed) );
+    if( AUDIO_QUALITY_HANN == window )
+    {
+      Window_hann( windowed, order );
+    }
+    else
+    {
+      windowBlackmanHarris( windowed, order );
+    }
+    src = windowed;
+  }
+  FFT_magnitude( mag, src, order );
+
+  // Anything near DC is offset, not signal or noise
+  int excluded = 0;
+  takeTone( mag, half, 0, lobe, &excluded );
+
+  int fundamental = 0;
+  Q_15 peak = 0;
+  for( int i=lobe+1; i<half; ++i)
+  {
+    if( mag[i] > peak )
+    {
+      peak = mag[i];
+      fundamental = i;
+    }
+  }
+  if( 0 == fundamental )
+  {
+    return 0;
+  }
+
+  result->fundamentalBin = fundamental;
+  result->fundamentalPower = takeTone( mag, half, fundamental, lobe, &excluded );
+
+  if( harmonics <= 0 )
+  {
+    harmonics = AUDIO_QUALITY_DEFAULT_HARMONICS;
+  }
+  for( int h=2; h<=harmonics; ++h)
+  {
+    // Fold harmonics above Nyquist back down to where they alias
+    int bin = (int)(((long)h * fundamental) % N);
+    if( bin > half )
+    {
+      bin = N - bin;
+    }
+    result->harmonicPower += takeTone( mag, half, bin, lobe, &excluded );
+  }
+
+  uint32_t noise = 0;
+  for( int i=0; i<half; ++i)
+  {
+    if( mag[i] > 0 )
+    {
+      noise += (uint32_t)mag[i] * (uint32_t)mag[i];
+    }
+  }
+  // Fill in the bins under the tones with the average noise per bin
+  if( excluded < half )
+  {
+    noise = (uint32_t)(((uint64_t)noise * half) / (half - excluded));
+  }
+  result->noisePower = noise;
+
+  result->thd_dB   = power_ratio_dB( result->harmonicPower, result->fundamentalPower );
+  result->snr_dB   = power_ratio_dB( result->fundamentalPower, noise );
+  result->sinad_dB = power_ratio_dB( result->fundamentalPower, noise + result->harmonicPower );
+  result->enob = (Q16_15)((((int64_t)(result->sinad_dB - SINAD_OFFSET_1_76)) * BITS_PER_DB) >> 15);
+
+  return fundamental;
+}
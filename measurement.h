@@ -0,0 +1,69 @@
+/**
+ * @file    measurement.h
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Audio path quality measurements (THD, SNR, SINAD and ENOB) made from a
+ * single spectrum of a captured test tone.
+ *
+ */
+#ifndef   MEASUREMENT_H
+#define   MEASUREMENT_H
+
+/* Includes ******************************************************************/
+#include <inttypes.h>
+#include "DSP.h"
+
+/* Defines *******************************************************************/
+// Number of harmonics (including the fundamental) used when none is given.
+#define AUDIO_QUALITY_DEFAULT_HARMONICS 5
+
+/* Types *********************************************************************/
+typedef enum AudioQualityWindow
+{
+  AUDIO_QUALITY_RECTANGULAR, ///< only for coherently sampled test tones
+  AUDIO_QUALITY_HANN,        ///< quick checks, leakage limits SNR to about 30dB off bin
+  AUDIO_QUALITY_BLACKMAN_HARRIS, ///< any tone, measures SNR to the limit of the FFT
+} AudioQualityWindow;
+
+typedef struct AudioQuality
+{
+  int      fundamentalBin;   ///< bin holding the test tone, 0 if none was found
+  uint32_t fundamentalPower; ///< sum of squared magnitudes over the tone's bins
+  uint32_t harmonicPower;    ///< sum over all harmonic bins
+  uint32_t noisePower;       ///< remaining bins, extrapolated over the full band
+  Q16_15   thd_dB;           ///< harmonics relative to the fundamental, negative
+  Q16_15   snr_dB;           ///< fundamental relative to noise
+  Q16_15   sinad_dB;         ///< fundamental relative to noise and distortion
+  Q16_15   enob;             ///< effective number of bits, from SINAD
+} AudioQuality;
+
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+/**
+ * Measures the quality of a test tone in a block of samples.
+ *
+ * A single FFT_magnitude of the (optionally windowed) block is used for
+ * everything. The strongest bin is taken as the fundamental, the power of the
+ * fundamental and each harmonic (folded back if it aliases past Nyquist) is
+ * integrated over the main lobe width of the window, and what is left is noise.
+ * The bins hidden under the tones and DC are filled in from the average noise
+ * density so the noise covers the whole band. As tones and noise are both
+ * summed as power, the window's noise bandwidth scales them equally and
+ * cancels out of the ratios.
+ *
+ * @note Needs 2 blocks of stack on top of FFT_magnitude, so keep order <= 7 on
+ * small AVRs.
+ *
+ * @param result where to write the measurement
+ * @param src the samples holding the test tone
+ * @param order the order of magnitude of the block. size = 2^order.
+ * @param harmonics the number of harmonics to count, including the fundamental
+ * @param window the window to apply before the transform
+ * @return the bin of the fundamental, 0 if no tone was found
+ */
+int AudioQuality_measure( AudioQuality* result, const Q_15* src, int order, int harmonics, AudioQualityWindow window );
+
+#endif // MEASUREMENT_H
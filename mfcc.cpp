@@ -0,0 +1,117 @@
+/**
+ * @file    mfcc.cpp
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Mel filterbank energies and Mel Frequency Cepstral Coefficients (MFCC).
+ *
+ */
+
+/* Includes ******************************************************************/
+#include "mfcc.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+/* Defines *******************************************************************/
+// The mel scale is log(1 + f/700), only differences in it are ever used so
+// log2(700 + f) is enough.
+#define MEL_BREAK_HZ 700
+
+/* Types *********************************************************************/
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+void MelFilterBank_init( MelFilterBank* fb, int order, uint16_t sampleRate, int filters, uint16_t lowHz, uint16_t highHz )
+{
+  // segment and weight hold the bins of at most an MFCC_MAX_ORDER frame
+  order = constrain( order, 1, MFCC_MAX_ORDER );
+  const int N=1<<order;
+  fb->order = order;
+  fb->filters = constrain( filters, 1, MFCC_MAX_FILTERS );
+
+  // filters+2 edges evenly spaced in mel make filters+1 segments
+  int32_t melLow = fixed_log2( MEL_BREAK_HZ + (uint32_t)lowHz );
+  uint32_t span = fixed_log2( MEL_BREAK_HZ + (uint32_t)highHz ) - melLow;
+  uint8_t segments = fb->filters + 1;
+
+  for( int k=0; k<=N/2; ++k)
+  {
+    uint32_t hz = ((uint32_t)k * sampleRate) >> order;
+    fb->segment[k] = MFCC_NO_FILTER;
+    fb->weight[k] = 0;
+    if( hz < lowHz || hz >= highHz )
+    {
+      continue;
+    }
+    uint32_t pos = (uint32_t)(fixed_log2( MEL_BREAK_HZ + hz ) - melLow) * segments;
+    fb->segment[k] = pos / span;
+    fb->weight[k] = (UQ1_15)(((uint64_t)(pos % span) << 15) / span);
+  }
+}
+
+void MelFilterBank_apply( const MelFilterBank* fb, uint32_t* energy, const Complex16* spectrum )
+{
+  const int bins=(1<<fb->order)/2 + 1;
+  memset( energy, 0, fb->filters * sizeof(*energy) );
+
+  for( int k=0; k<bins; ++k)
+  {
+    uint8_t seg = fb->segment[k];
+    if( MFCC_NO_FILTER == seg )
+    {
+      continue;
+    }
+    uint32_t p = (int32_t)spectrum[k].real * spectrum[k].real
+               + (int32_t)spectrum[k].imag * spectrum[k].imag;
+
+    // p*weight without overflowing 32 bits, the rest falls to the filter below
+    uint32_t rise = (p >> 15) * fb->weight[k] + (((p & 0x7FFF) * fb->weight[k]) >> 15);
+    if( seg < fb->filters )
+    {
+      energy[seg] += rise;
+    }
+    if( seg > 0 )
+    {
+      energy[seg - 1] += p - rise;
+    }
+  }
+}
+
+void MFCC_compute( const MelFilterBank* fb, Q16_15* ceps, int count, const Q_15* frame )
+{
+  const int N=1<<fb->order;
+  const int M=fb->filters;
+  Q_15 windowed[N];
+  Complex16 spectrum[N];
+  uint32_t energy[MFCC_MAX_FILTERS];
+  Q16_15 logEnergy[MFCC_MAX_FILTERS];
+
+  memcpy( windowed, frame, sizeof(windowed) );
+  Window_hann( windowed, fb->order );
+  Real2Complex_FFT( spectrum, windowed, fb->order );
+  MelFilterBank_apply( fb, energy, spectrum );
+
+  for( int m=0; m<M; ++m)
+  {
+    logEnergy[m] = fixed_log2( energy[m] );
+  }
+
+  // DCT-II: c[k] = sum( L[m] * cos( pi*k*(m+1/2)/M ) )
+  for( int k=0; k<count; ++k)
+  {
+    // pi*k*(2m+1)/(2M) in BAM16, stepping m adds 2 of the half steps
+    BAM16 step = (BAM16)(((uint32_t)k << 14) / M);
+    BAM16 angle = step;
+    int32_t sum = 0;
+    for( int m=0; m<M; ++m)
+    {
+      // L*cos without overflowing 32 bits, L reaches 32 in Q16_15
+      Q_15 c = cosine_lerp( angle );
+      sum += (logEnergy[m] >> 15) * c + Q15_mult( logEnergy[m] & 0x7FFF, c );
+      angle += step << 1;
+    }
+    ceps[k] = sum;
+  }
+}
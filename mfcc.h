@@ -0,0 +1,86 @@
+/**
+ * @file    mfcc.h
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Mel filterbank energies and Mel Frequency Cepstral Coefficients (MFCC) for
+ * feeding small keyword and event classifiers.
+ *
+ *  frame -> Hann window -> FFT -> |X|^2 -> mel filters -> log2 -> DCT-II
+ *
+ * Per frame cost is one 2^order point FFT, one multiply per bin for the
+ * filterbank, a fixed_log2 per filter and filters*coeffs multiplies for the
+ * DCT. At 8kHz an order 7 frame (16ms) with 50% overlap leaves 8ms per frame,
+ * and order 7 also keeps the working buffers inside an ATmega328P's RAM.
+ *
+ */
+#ifndef   MFCC_H
+#define   MFCC_H
+
+/* Includes ******************************************************************/
+#include <inttypes.h>
+#include "DSP.h"
+
+/* Defines *******************************************************************/
+// FIXED SIZE allows for a lot of optimizations vs parameterized size.
+#define MFCC_MAX_ORDER   8
+#define MFCC_MAX_BINS    ((1 << MFCC_MAX_ORDER)/2 + 1)
+#define MFCC_MAX_FILTERS 32
+
+// Marks a bin outside every filter
+#define MFCC_NO_FILTER   0xFF
+
+/* Types *********************************************************************/
+
+/**
+ * Sparse triangular mel filters. Neighbouring filters overlap so every bin is
+ * on the rising slope of one filter and the falling slope of the one below.
+ * Only the rising weight is stored, the falling weight is 1 minus it.
+ */
+typedef struct MelFilterBank
+{
+  uint8_t segment[MFCC_MAX_BINS]; ///< filter whose rising slope holds the bin
+  UQ1_15  weight[MFCC_MAX_BINS];  ///< weight of the bin on that rising slope
+  uint8_t order;
+  uint8_t filters;
+} MelFilterBank;
+
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+/**
+ * Lays out filters triangular filters evenly on the mel scale between lowHz
+ * and highHz. Uses only integer math so it can be called on the target.
+ *
+ * @param fb the MelFilterBank to initialize
+ * @param order the order of magnitude of the frames. size = 2^order, at most
+ *        MFCC_MAX_ORDER. Larger orders are clamped to it.
+ * @param sampleRate the sample rate of the frames in Hz
+ * @param filters the number of filters, at most MFCC_MAX_FILTERS
+ * @param lowHz the lower edge of the lowest filter
+ * @param highHz the upper edge of the highest filter, at most sampleRate/2
+ */
+void MelFilterBank_init( MelFilterBank* fb, int order, uint16_t sampleRate, int filters, uint16_t lowHz, uint16_t highHz );
+
+/**
+ * Applies the filterbank to the power spectrum of a frame.
+ *
+ * @param fb the MelFilterBank
+ * @param energy where to write the filters energies
+ * @param spectrum the bins 0..N/2 of a Real2Complex_FFT of the frame
+ */
+void MelFilterBank_apply( const MelFilterBank* fb, uint32_t* energy, const Complex16* spectrum );
+
+/**
+ * Calculates the MFCCs of a frame.
+ * The coefficients are in log2 units, the DCT is not normalized.
+ *
+ * @param fb the MelFilterBank
+ * @param ceps where to write the count cepstral coefficients
+ * @param count the number of coefficients to calculate, coefficient 0 is the log energy
+ * @param frame the 2^order samples of the frame
+ */
+void MFCC_compute( const MelFilterBank* fb, Q16_15* ceps, int count, const Q_15* frame );
+
+#endif // MFCC_H
@@ -0,0 +1,148 @@
+/**
+ * @file    octave.cpp
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Continuous 1/1 and 1/3 octave band levels from a multirate IIR filter bank.
+ *
+ */
+
+/* Includes ******************************************************************/
+#include "octave.h"
+
+#include <Arduino.h>
+
+/* Defines *******************************************************************/
+// Mean square of a full scale sine wave in Q_30
+#define FULL_SCALE_SINE_POWER 0x20000000UL
+
+/* Types *********************************************************************/
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+
+/**
+ *  4th order Butterworth low pass at 0.2*fs as two sections. Passes the lower
+ *  octaves (< fs/8) flat and stops what would alias onto them (> 3*fs/8).
+ *
+ *  Generator (RBJ cookbook, Q = 0.5412 and 1.3066):
+ *   w0 = 2*pi*0.2; alpha = sin(w0)/(2*Q)
+ *   b0 = b2 = (1-cos(w0))/2/(1+alpha); b1 = 2*b0
+ *   a1 = -2*cos(w0)/(1+alpha); a2 = (1-alpha)/(1+alpha)
+ */
+static const Biquad16Coeffs ANTI_ALIAS[2] =
+{
+  { 3013, 6026, 3013, -5390, 1058 },
+  { 4150, 8300, 4150, -7424, 7640 },
+};
+
+/**
+ *  Constant peak gain band pass for the octave [fs/8 .. fs/4], centered at
+ *  fs*sqrt(2)/8.
+ *
+ *  Generator (RBJ cookbook, BW in octaves):
+ *   alpha = sin(w0)*sinh(ln(2)/2*BW*w0/sin(w0))
+ *   b0 = alpha/(1+alpha); b1 = 0; b2 = -b0
+ *   a1 = -2*cos(w0)/(1+alpha); a2 = (1-alpha)/(1+alpha)
+ */
+static const Biquad16Coeffs OCTAVE_BAND =
+  { 4655, 0, -4655, -10416, 7074 };
+
+/**
+ *  Third octave bands splitting the octave above, centered at
+ *  fs*sqrt(2)/8 * 2^(1/3), fs*sqrt(2)/8 and fs*sqrt(2)/8 * 2^(-1/3).
+ *  Same generator with BW = 1/3.
+ */
+static const Biquad16Coeffs THIRD_OCTAVE_BAND[3] =
+{
+  { 2289, 0, -2289,  -4807, 11806 },
+  { 1869, 0, -1869, -12890, 12646 },
+  { 1518, 0, -1518, -18907, 13347 },
+};
+
+/* Functions *****************************************************************/
+
+void OctaveBank_init( OctaveBank* bank, int stages, OctaveMode mode, int shift )
+{
+  bank->stages = constrain( stages, 1, OCTAVE_MAX_STAGES );
+  bank->bandsPerStage = (OCTAVE_THIRD == mode) ? 3 : 1;
+  bank->shift = shift;
+  for( int k=0; k<OCTAVE_MAX_STAGES; ++k)
+  {
+    OctaveStage* st = &bank->stage[k];
+    Biquad16_init( &st->antiAlias[0] );
+    Biquad16_init( &st->antiAlias[1] );
+    for( int b=0; b<3; ++b)
+    {
+      Biquad16_init( &st->band[b] );
+    }
+    st->skip = 0;
+  }
+  for( int i=0; i<OCTAVE_MAX_BANDS; ++i)
+  {
+    bank->energy[i] = 0;
+  }
+}
+
+void OctaveBank_push( OctaveBank* bank, Q_15 sample )
+{
+  const Biquad16Coeffs* bands = (3 == bank->bandsPerStage) ? THIRD_OCTAVE_BAND : &OCTAVE_BAND;
+  uint32_t* energy = bank->energy;
+
+  for( int k=0; k<bank->stages; ++k)
+  {
+    OctaveStage* st = &bank->stage[k];
+
+    // Lower stages see fewer samples, so average over fewer of them to keep
+    // the same time constant.
+    int shift = bank->shift - k;
+    if( shift < 0 )
+    {
+      shift = 0;
+    }
+
+    for( int b=0; b<bank->bandsPerStage; ++b)
+    {
+      int32_t y = Biquad16_step( &st->band[b], &bands[b], sample );
+      int32_t diff = (y * y) - (int32_t)*energy;
+      *energy++ += diff >> shift;
+    }
+
+    // Decimate by 2 into the next octave
+    sample = Biquad16_step( &st->antiAlias[0], &ANTI_ALIAS[0], sample );
+    sample = Biquad16_step( &st->antiAlias[1], &ANTI_ALIAS[1], sample );
+    st->skip ^= 1;
+    if( st->skip )
+    {
+      break;
+    }
+  }
+}
+
+void OctaveBank_pushBlock( OctaveBank* bank, const Q_15* buf, int count )
+{
+  while( count-- )
+  {
+    OctaveBank_push( bank, *buf++ );
+  }
+}
+
+int OctaveBank_bands( OctaveBank* bank )
+{
+  return bank->stages * bank->bandsPerStage;
+}
+
+uint16_t OctaveBank_centerHz( OctaveBank* bank, int band, uint16_t sampleRate )
+{
+  // Top octave center is fs*sqrt(2)/8, third octaves step by 2^(1/3)
+  // hex(sqrt(2)/8*0x10000+0.5), hex(sqrt(2)/8*2^(1/3)*0x10000+0.5), ...
+  static const uint16_t THIRD_CENTER[3] = { 0x3904, 0x2D41, 0x23EB };
+  int stage = band / bank->bandsPerStage;
+  uint16_t ratio = (3 == bank->bandsPerStage) ? THIRD_CENTER[band % 3] : THIRD_CENTER[1];
+
+  return (uint16_t)((((uint32_t)sampleRate * ratio) >> 16) >> stage);
+}
+
+Q16_15 OctaveBank_level_dB( OctaveBank* bank, int band )
+{
+  return power_ratio_dB( bank->energy[band], FULL_SCALE_SINE_POWER );
+}
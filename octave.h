@@ -0,0 +1,111 @@
+/**
+ * @file    octave.h
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Continuous 1/1 and 1/3 octave band levels from a multirate IIR filter bank.
+ *
+ * Each stage of the bank runs at half the rate of the one above it, so the
+ * bands of every stage sit at the same fraction of that stage's sample rate
+ * and all stages share one set of coefficients. The stage sample rate drops by
+ * 2 per octave, so the whole bank costs less than twice its top stage.
+ *
+ *  stage k rate = fs / 2^k
+ *  stage k octave band = [fs/2^(k+3) .. fs/2^(k+2)]
+ *
+ */
+#ifndef   OCTAVE_H
+#define   OCTAVE_H
+
+/* Includes ******************************************************************/
+#include <inttypes.h>
+#include "DSP.h"
+
+/* Defines *******************************************************************/
+// FIXED SIZE allows for a lot of optimizations vs parameterized size.
+#define OCTAVE_MAX_STAGES 8
+#define OCTAVE_MAX_BANDS  (3*OCTAVE_MAX_STAGES)
+
+/* Types *********************************************************************/
+typedef enum OctaveMode
+{
+  OCTAVE_FULL,  ///< one band per octave
+  OCTAVE_THIRD, ///< three bands per octave
+} OctaveMode;
+
+typedef struct OctaveStage
+{
+  Biquad16 antiAlias[2];  ///< 4th order low pass ahead of the decimator
+  Biquad16 band[3];       ///< band pass filters for this octave
+  uint8_t  skip;          ///< toggles to drop every other sample
+} OctaveStage;
+
+typedef struct OctaveBank
+{
+  OctaveStage stage[OCTAVE_MAX_STAGES];
+  uint32_t    energy[OCTAVE_MAX_BANDS]; ///< mean square of each band, Q_30
+  uint8_t     stages;
+  uint8_t     bandsPerStage;
+  uint8_t     shift;       ///< averaging time constant at the top stage
+} OctaveBank;
+
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+/**
+ * Initializes an OctaveBank
+ *
+ * @param bank the OctaveBank to initialize
+ * @param stages the number of octaves to cover, at most OCTAVE_MAX_STAGES
+ * @param mode full or third octave bands
+ * @param shift the band energy averaging time constant is 2^shift samples
+ */
+void OctaveBank_init( OctaveBank* bank, int stages, OctaveMode mode, int shift );
+
+/**
+ * Runs one sample through the filter bank, updating all band energies whose
+ * stage is due a sample.
+ *
+ * @param bank the OctaveBank
+ * @param sample the next input sample
+ */
+void OctaveBank_push( OctaveBank* bank, Q_15 sample );
+
+/**
+ * Runs a block of samples through the filter bank.
+ *
+ * @param bank the OctaveBank
+ * @param buf the samples
+ * @param count the number of samples in buf
+ */
+void OctaveBank_pushBlock( OctaveBank* bank, const Q_15* buf, int count );
+
+/**
+ * Returns the number of bands in the bank. Band 0 is the highest frequency.
+ *
+ * @param bank the OctaveBank
+ * @return number of bands
+ */
+int OctaveBank_bands( OctaveBank* bank );
+
+/**
+ * Returns the nominal center frequency of a band.
+ *
+ * @param bank the OctaveBank
+ * @param band the band index, 0 is highest
+ * @param sampleRate the input sample rate in Hz
+ * @return center frequency in Hz
+ */
+uint16_t OctaveBank_centerHz( OctaveBank* bank, int band, uint16_t sampleRate );
+
+/**
+ * Returns the level of a band relative to a full scale sine wave.
+ *
+ * @param bank the OctaveBank
+ * @param band the band index, 0 is highest
+ * @return level in dBFS as Q16_15
+ */
+Q16_15 OctaveBank_level_dB( OctaveBank* bank, int band );
+
+#endif // OCTAVE_H
@@ -0,0 +1,128 @@
+/**
+ * @file    onset.cpp
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Onset and transient detection with spectral flux.
+ *
+ */
+
+/* Includes ******************************************************************/
+#include "onset.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+/* Defines *******************************************************************/
+/* Types *********************************************************************/
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+void Onset_init( OnsetDetector* od, int order, uint8_t factorQ4, uint32_t minFlux )
+{
+  memset( od, 0, sizeof(*od) );
+  od->order = constrain( order, 2, ONSET_MAX_ORDER );
+  od->factor = factorQ4;
+  od->minFlux = minFlux;
+}
+
+void Onset_setIndex( OnsetDetector* od, uint32_t index )
+{
+  od->sampleIndex = index;
+}
+
+/**
+ * Finds the attack inside a frame of two hops, the first sample reaching half
+ * the frame's peak level.
+ *
+ * @param first the older hop of the frame
+ * @param second the newer hop of the frame
+ * @param count samples per hop
+ * @return offset of the attack from the start of the frame
+ */
+static int attackOffset( const Q_15* first, const Q_15* second, int count )
+{
+  Q_15 peak = 0;
+  for( int i=0; i<count; ++i)
+  {
+    peak = max( peak, (Q_15)abs( first[i] ) );
+    peak = max( peak, (Q_15)abs( second[i] ) );
+  }
+  peak >>= 1;
+  for( int i=0; i<count; ++i)
+  {
+    if( abs( first[i] ) >= peak )
+    {
+      return i;
+    }
+  }
+  for( int i=0; i<count; ++i)
+  {
+    if( abs( second[i] ) >= peak )
+    {
+      return count + i;
+    }
+  }
+  return 0;
+}
+
+bool Onset_process( OnsetDetector* od, const Q_15* hop, uint32_t* onsetIndex )
+{
+  const int N=1<<od->order;
+  const int half=N>>1;
+  Q_15 frame[N];
+  Complex16 spectrum[N];
+  bool onset = false;
+
+  memcpy( frame, od->history, half * sizeof(Q_15) );
+  memcpy( frame + half, hop, half * sizeof(Q_15) );
+  Window_hann( frame, od->order );
+  Real2Complex_FFT( spectrum, frame, od->order );
+
+  // Flux is the total growth of the bins since the previous frame
+  uint32_t flux = 0;
+  for( int k=0; k<=half; ++k)
+  {
+    Q_15 mag = CORDIC16_rect2polar( spectrum[k] ).mag;
+    if( mag > od->lastMag[k] )
+    {
+      flux += mag - od->lastMag[k];
+    }
+    od->lastMag[k] = mag;
+  }
+
+  uint8_t mask = ONSET_HISTORY - 1;
+  od->flux[od->head] = flux;
+  od->head = (od->head + 1) & mask;
+  if( od->frames < ONSET_HISTORY )
+  {
+    ++od->frames;
+  }
+  else
+  {
+    // The previous frame is a peak if it beats both neighbours and the
+    // threshold. Its samples are the two hops still in older and history.
+    uint32_t prev  = od->flux[(od->head - 2) & mask];
+    uint32_t prev2 = od->flux[(od->head - 3) & mask];
+    uint32_t mean = 0;
+    for( int i=0; i<ONSET_HISTORY; ++i)
+    {
+      mean += od->flux[i];
+    }
+    mean >>= ONSET_HISTORY_ORDER;
+    uint32_t threshold = ((mean * od->factor) >> 4) + od->minFlux;
+
+    if( prev > prev2 && prev >= flux && prev > threshold )
+    {
+      *onsetIndex = od->sampleIndex - N + attackOffset( od->older, od->history, half );
+      onset = true;
+    }
+  }
+
+  memcpy( od->older, od->history, half * sizeof(Q_15) );
+  memcpy( od->history, hop, half * sizeof(Q_15) );
+  od->sampleIndex += half;
+
+  return onset;
+}
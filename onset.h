@@ -0,0 +1,89 @@
+/**
+ * @file    onset.h
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Onset and transient detection with spectral flux.
+ *
+ * Half overlapping frames are transformed once per hop and compared with the
+ * previous frame's magnitudes, so each new hop costs a single FFT. The flux,
+ * the sum of the bins that grew, is peak picked against an adaptive threshold
+ * and the onset is then placed on a single sample inside the frame it
+ * arrived in. Detections are reported one hop late, when the peak is
+ * confirmed.
+ *
+ *     uint32_t when;
+ *     while( SampleBuffer_popAllOrNothing( &sb, hop, 64 ) )
+ *     {
+ *       if( Onset_process( &od, hop, &when ) )
+ *       {
+ *         logEvent( when );
+ *       }
+ *     }
+ *
+ */
+#ifndef   ONSET_H
+#define   ONSET_H
+
+/* Includes ******************************************************************/
+#include <inttypes.h>
+#include "DSP.h"
+
+/* Defines *******************************************************************/
+// FIXED SIZE allows for a lot of optimizations vs parameterized size.
+#define ONSET_MAX_ORDER 8
+#define ONSET_MAX_HOP   (1 << (ONSET_MAX_ORDER - 1))
+
+// Number of past flux values averaged for the threshold, a power of 2
+#define ONSET_HISTORY_ORDER 3
+#define ONSET_HISTORY (1 << ONSET_HISTORY_ORDER)
+
+/* Types *********************************************************************/
+typedef struct OnsetDetector
+{
+  Q_15     history[ONSET_MAX_HOP];    ///< previous hop of input
+  Q_15     older[ONSET_MAX_HOP];      ///< the hop before history
+  Q_15     lastMag[ONSET_MAX_HOP + 1];///< magnitudes of the previous frame
+  uint32_t flux[ONSET_HISTORY];       ///< recent flux values, newest at head-1
+  uint32_t sampleIndex;               ///< stream index of the next input sample
+  uint32_t minFlux;                   ///< flux below this is never an onset
+  uint8_t  factor;                    ///< threshold over the mean flux, UQ4_4
+  uint8_t  order;
+  uint8_t  head;
+  uint8_t  frames;                    ///< frames seen, up to ONSET_HISTORY
+} OnsetDetector;
+
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+/**
+ * Initializes an OnsetDetector
+ *
+ * @param od the OnsetDetector to initialize
+ * @param order the order of magnitude of the frames, at most ONSET_MAX_ORDER. size = 2^order.
+ * @param factorQ4 threshold as a multiple of the recent mean flux in 1/16ths
+ * @param minFlux flux that must be exceeded regardless of the mean
+ */
+void Onset_init( OnsetDetector* od, int order, uint8_t factorQ4, uint32_t minFlux );
+
+/**
+ * Sets the stream index of the next sample passed to Onset_process, to line
+ * the reported onsets up with a SampleBuffer or capture.
+ *
+ * @param od the OnsetDetector
+ * @param index the stream index of the next sample
+ */
+void Onset_setIndex( OnsetDetector* od, uint32_t index );
+
+/**
+ * Adds one hop (half a frame) of samples.
+ *
+ * @param od the OnsetDetector
+ * @param hop the next 2^(order-1) samples
+ * @param onsetIndex where to write the stream index of a detected onset
+ * @return true if an onset was detected
+ */
+bool Onset_process( OnsetDetector* od, const Q_15* hop, uint32_t* onsetIndex );
+
+#endif // ONSET_H
@@ -0,0 +1,189 @@
+/**
+ * @file    profile.cpp
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Hot path instrumentation, see profile.h.
+ *
+ */
+
+/* Includes ******************************************************************/
+#include "profile.h"
+
+#include <Arduino.h>
+
+#if defined(FPDSP_PROFILE)
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* Defines *******************************************************************/
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_8M_MAIN__)
+#define PROFILE_DWT
+#define DEMCR      (*(volatile uint32_t*)0xE000EDFCUL)
+#define DWT_CTRL   (*(volatile uint32_t*)0xE0001000UL)
+#define DWT_CYCCNT (*(volatile uint32_t*)0xE0001004UL)
+#define DEMCR_TRCENA         (1UL << 24)
+#define DWT_CTRL_CYCCNTENA   (1UL << 0)
+#endif
+
+/* Types *********************************************************************/
+#if !defined(ARDUINO)
+typedef struct ProfileEvent
+{
+  ProfileTicks start;
+  ProfileTicks duration;
+  uint8_t      id;
+} ProfileEvent;
+#endif
+
+/* Interfaces ****************************************************************/
+#if defined(__AVR__)
+// Counted by the Timer 0 overflow interrupt in the Arduino core (wiring.c)
+extern volatile unsigned long timer0_overflow_count;
+#endif
+
+/* Data **********************************************************************/
+ProfileStat Profile_stats[PROFILE_COUNT];
+
+#define PROFILE_NAME(NAME) static const char PROFILE_NAME_##NAME[] PROGMEM = #NAME;
+PROFILE_KERNELS(PROFILE_NAME)
+#undef PROFILE_NAME
+
+#define PROFILE_NAME(NAME) PROFILE_NAME_##NAME,
+static const char* const PROFILE_NAMES[PROFILE_COUNT] PROGMEM =
+{
+  PROFILE_KERNELS(PROFILE_NAME)
+};
+#undef PROFILE_NAME
+
+#if !defined(ARDUINO)
+static ProfileEvent events[PROFILE_TRACE_EVENTS];
+static uint32_t eventCount;
+static uint32_t eventsDropped;
+
+// Tick and wall clock at Profile_reset, to convert ticks to time
+static ProfileTicks resetTicks;
+static struct timespec resetTime;
+#endif
+
+/* Functions *****************************************************************/
+
+ProfileTicks Profile_now( void )
+{
+#if defined(__AVR__)
+  uint8_t sreg = SREG;
+  cli();
+  uint32_t overflows = timer0_overflow_count;
+  uint8_t ticks = TCNT0;
+  // An overflow not yet serviced, as in micros()
+  if( (TIFR0 & _BV(TOV0)) && ticks < 255 )
+  {
+    ++overflows;
+  }
+  SREG = sreg;
+  return (overflows << 8) | ticks;
+#elif defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(PROFILE_DWT)
+  return DWT_CYCCNT;
+#elif defined(ARDUINO)
+  return micros();
+#else
+  struct timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  return (ProfileTicks)now.tv_sec * 1000000000ULL + now.tv_nsec;
+#endif
+}
+
+void Profile_reset( void )
+{
+#if defined(PROFILE_DWT)
+  DEMCR |= DEMCR_TRCENA;
+  DWT_CYCCNT = 0;
+  DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+#endif
+
+  memset( Profile_stats, 0, sizeof(Profile_stats) );
+
+#if !defined(ARDUINO)
+  eventCount = 0;
+  eventsDropped = 0;
+  clock_gettime( CLOCK_MONOTONIC, &resetTime );
+  resetTicks = Profile_now();
+#endif
+}
+
+void Profile_record( ProfileId id, ProfileTicks start )
+{
+  ProfileTicks duration = Profile_now() - start;
+  ProfileStat* stat = &Profile_stats[id];
+
+  ++stat->calls;
+  stat->total += duration;
+  if( duration > stat->max )
+  {
+    stat->max = duration;
+  }
+
+#if !defined(ARDUINO)
+  if( eventCount < PROFILE_TRACE_EVENTS )
+  {
+    ProfileEvent* e = &events[eventCount++];
+    e->start = start;
+    e->duration = duration;
+    e->id = (uint8_t)id;
+  }
+  else
+  {
+    ++eventsDropped;
+  }
+#endif
+}
+
+const char* Profile_name( ProfileId id )
+{
+  return (const char*)pgm_read_ptr( &PROFILE_NAMES[id] );
+}
+
+#if !defined(ARDUINO)
+bool Profile_writeChromeTrace( FILE* out )
+{
+  struct timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  ProfileTicks ticks = Profile_now() - resetTicks;
+  double ns = (now.tv_sec - resetTime.tv_sec) * 1e9 + (now.tv_nsec - resetTime.tv_nsec);
+  double usPerTick = (ticks && ns > 0) ? ns / 1000.0 / ticks : 0.001;
+
+  fprintf( out, "{\"traceEvents\":[\n" );
+  for( uint32_t i=0; i<eventCount; ++i)
+  {
+    const ProfileEvent* e = &events[i];
+    fprintf( out, "{\"name\":\"%s\",\"cat\":\"fpDSP\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                  "\"ts\":%.3f,\"dur\":%.3f}%s\n",
+             Profile_name( (ProfileId)e->id ),
+             (double)(e->start - resetTicks) * usPerTick,
+             (double)e->duration * usPerTick,
+             (i + 1 < eventCount) ? "," : "" );
+  }
+  fprintf( out, "],\n\"displayTimeUnit\":\"ns\",\n\"otherData\":{\n" );
+  fprintf( out, "\"cyclesPerTick\":%d,\"usPerTick\":%.6g,\"droppedEvents\":%" PRIu32,
+           PROFILE_CYCLES_PER_TICK, usPerTick, eventsDropped );
+  for( int id=0; id<PROFILE_COUNT; ++id)
+  {
+    const ProfileStat* stat = &Profile_stats[id];
+    if( stat->calls )
+    {
+      fprintf( out, ",\n\"%s\":\"calls %" PRIu32 " total %" PRIu64 " max %" PRIu64 " ticks\"",
+               Profile_name( (ProfileId)id ), stat->calls,
+               (uint64_t)stat->total, (uint64_t)stat->max );
+    }
+  }
+  fprintf( out, "\n}}\n" );
+
+  return !ferror( out );
+}
+#endif
+
+#endif // FPDSP_PROFILE
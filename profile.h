@@ -0,0 +1,165 @@
+/**
+ * @file    profile.h
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * Hot path instrumentation. Each kernel in DSP.cpp is bracketed by
+ * PROFILE_BEGIN and PROFILE_END, which accumulate call counts, total and
+ * maximum ticks per kernel into a fixed table.
+ *
+ * Only built when FPDSP_PROFILE is defined, otherwise the macros are empty
+ * and the kernels cost nothing extra. Times include nested kernels, so
+ * FFT_magnitude includes the FFT_inphase and CORDIC16_rect2polar it calls.
+ * The AVR assembly kernels (FPDSP_AVR_ASM) are not instrumented, time them
+ * from the caller with one of the PROFILE_STAGE slots.
+ *
+ * Ticks are
+ *  - AVR: Timer 0 counts, 64 cycles each, from the Arduino millis() timer
+ *  - x86: rdtsc
+ *  - ARM Cortex-M3/M4/M7/M33: the DWT cycle counter, started by Profile_reset
+ *  - otherwise micros() on a board or nanoseconds on a host
+ *
+ * On a host every call is also logged, up to PROFILE_TRACE_EVENTS of them,
+ * and can be written as Chrome trace JSON for chrome://tracing or Perfetto.
+ * Not thread safe.
+ *
+ */
+#ifndef   PROFILE_H
+#define   PROFILE_H
+
+/* Includes ******************************************************************/
+#include <inttypes.h>
+
+#if !defined(ARDUINO)
+#include <stdio.h>
+#endif
+
+/* Defines *******************************************************************/
+
+/**
+ * Everything that can be timed. Kernels are named after their function, the
+ * STAGE slots are free for application code.
+ */
+#define PROFILE_KERNELS(X)            \
+  X(Q15_MAC)                          \
+  X(CORDIC16_rotate)                  \
+  X(CORDIC16_rect2polar)              \
+  X(powerMeasurement_inphase)         \
+  X(powerMeasurement_magnitude)       \
+  X(Window_hann)                      \
+  X(FFT_inphase)                      \
+  X(FFT_magnitude)                    \
+  X(IFT_magnitude)                    \
+  X(Complex_FFT)                      \
+  X(Complex_IFT)                      \
+  X(Real2Complex_FFT)                 \
+  X(Complex2Real_IFT)                 \
+  X(Biquad16_step)                    \
+  X(STAGE0)                           \
+  X(STAGE1)                           \
+  X(STAGE2)                           \
+  X(STAGE3)
+
+#if defined(__AVR__)
+#define PROFILE_CYCLES_PER_TICK 64
+#elif defined(__x86_64__) || defined(__i386__) || \
+      defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_8M_MAIN__)
+#define PROFILE_CYCLES_PER_TICK 1
+#else
+#define PROFILE_CYCLES_PER_TICK 0  // ticks are time, not cycles
+#endif
+
+#ifndef PROFILE_TRACE_EVENTS
+#define PROFILE_TRACE_EVENTS 65536
+#endif
+
+#if defined(FPDSP_PROFILE)
+/**
+ * Starts timing ID, one of PROFILE_KERNELS, in the current scope.
+ */
+#define PROFILE_BEGIN(ID) const ProfileTicks profile_##ID = Profile_now()
+
+/**
+ * Stops timing ID and records the call.
+ */
+#define PROFILE_END(ID) Profile_record( PROFILE_##ID, profile_##ID )
+#else
+#define PROFILE_BEGIN(ID)
+#define PROFILE_END(ID)
+#endif
+
+/* Types *********************************************************************/
+#if defined(__x86_64__) || defined(__i386__) || !defined(ARDUINO)
+typedef uint64_t ProfileTicks;
+#else
+typedef uint32_t ProfileTicks;
+#endif
+
+#define PROFILE_ENUM(NAME) PROFILE_##NAME,
+typedef enum ProfileId
+{
+  PROFILE_KERNELS(PROFILE_ENUM)
+  PROFILE_COUNT
+} ProfileId;
+#undef PROFILE_ENUM
+
+typedef struct ProfileStat
+{
+  uint32_t     calls;
+  ProfileTicks total;
+  ProfileTicks max;
+} ProfileStat;
+
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+#if defined(FPDSP_PROFILE)
+extern ProfileStat Profile_stats[PROFILE_COUNT];
+#endif
+
+/* Functions *****************************************************************/
+#if defined(FPDSP_PROFILE)
+
+/**
+ * Clears the table and trace, and starts the cycle counter where it needs
+ * starting.
+ */
+void Profile_reset( void );
+
+/**
+ * Reads the tick counter.
+ *
+ * @return the current time in ticks
+ */
+ProfileTicks Profile_now( void );
+
+/**
+ * Records one call of id, see PROFILE_END.
+ *
+ * @param id what was timed
+ * @param start Profile_now() when it started
+ */
+void Profile_record( ProfileId id, ProfileTicks start );
+
+/**
+ * The name of a kernel.
+ *
+ * @param id the kernel
+ * @return its name, in PROGMEM on AVR
+ */
+const char* Profile_name( ProfileId id );
+
+#if !defined(ARDUINO)
+/**
+ * Writes every call logged since Profile_reset as Chrome trace JSON
+ * complete events, with the totals per kernel in otherData. Ticks are
+ * converted to microseconds against the wall clock.
+ *
+ * @param out the file to write to
+ * @return true if everything was written
+ */
+bool Profile_writeChromeTrace( FILE* out );
+#endif
+
+#endif // FPDSP_PROFILE
+
+#endif // PROFILE_H
@@ -0,0 +1,189 @@
+/**
+ * @file    psk.cpp
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * BPSK and QPSK demodulator with carrier and symbol timing recovery.
+ *
+ */
+
+/* Includes ******************************************************************/
+#include "psk.h"
+
+#include <Arduino.h>
+
+/* Defines *******************************************************************/
+// Carrier loop gains, applied to the phase error of each symbol
+#define PSK_PHASE_SHIFT 2   // proportional, 1/4 of the error
+#define PSK_FREQ_SHIFT  5   // integral, 1/32 of the error per symbol
+
+// Frequency detector gain, 1/8 of the measured offset per half symbol
+#define PSK_FLL_SHIFT   3
+
+// Timing error (Q_15 of the symbol energy) that moves the strobe one sample
+#define PSK_TIMING_STEP 0x2000
+
+/* Types *********************************************************************/
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+void PSKDemod_init( PSKDemod* psk, BAM16 carrier, uint16_t samplesPerSymbol, PSKMode mode )
+{
+  psk->phase = 0;
+  psk->freq = carrier;
+  psk->freqError = 0;
+  psk->sumI = 0;
+  psk->sumQ = 0;
+  psk->half = { 0, 0 };
+  psk->mid = { 0, 0 };
+  psk->last = { 0, 0 };
+  psk->lastPhase = 0;
+  psk->timing = 0;
+  psk->halfLength = max( samplesPerSymbol >> 1, 1 );
+  psk->count = 0;
+  psk->mode = mode;
+  psk->atSymbol = false;
+
+  // The frequency detector's unambiguous range, 90 degrees (BPSK) or 45
+  // (QPSK) per half symbol
+  BAM16 range = ((PSK_QPSK == mode) || (PSK_DQPSK == mode)) ? BAM16_45_DEGREES : BAM16_90_DEGREES;
+  psk->freqLimit = ((int32_t)range << 8) / psk->halfLength;
+
+  // A symbol integral of a full scale carrier is samplesPerSymbol/2
+  psk->shift = 0;
+  while( (1UL << psk->shift) < psk->halfLength )
+  {
+    ++psk->shift;
+  }
+}
+
+/**
+ * Frequency detector, run on each pair of half symbol integrals. The turn
+ * from one to the next is the carrier offset over half a symbol plus any
+ * modulation between them, a multiple of 180 degrees (BPSK) or 90 (QPSK).
+ * Multiplying the angle by 2 or 4 wraps the modulation away, as squaring or
+ * raising the signal to the 4th would, so this works before symbol timing
+ * has settled and without decisions. Offsets under a quarter (BPSK) or an
+ * eighth (QPSK) of the symbol rate are measured unambiguously.
+ */
+static void frequencyDetector( PSKDemod* psk, Complex16 a, Complex16 b )
+{
+  // b * conj(a), halved so the sums can't overflow
+  Complex16 turn = {
+    (Q_15)((((int32_t)b.I * a.I) >> 16) + (((int32_t)b.Q * a.Q) >> 16)),
+    (Q_15)((((int32_t)b.Q * a.I) >> 16) - (((int32_t)b.I * a.Q) >> 16)) };
+  if( !turn.I && !turn.Q )
+  {
+    return;
+  }
+
+  uint8_t order = ((PSK_QPSK == psk->mode) || (PSK_DQPSK == psk->mode)) ? 2 : 1;
+  int16_t wrapped = (int16_t)(BAM16)(CORDIC16_rect2polar( turn ).phase << order);
+  int32_t offset = ((int32_t)wrapped << 8) >> order;  // BAM16 per half symbol * 2^8
+
+  psk->freqError += (offset / psk->halfLength) >> PSK_FLL_SHIFT;
+  psk->freqError = constrain( psk->freqError, -psk->freqLimit, psk->freqLimit );
+}
+
+/**
+ * Decides the bits of a carrier corrected symbol.
+ */
+static uint8_t decide( PSKDemod* psk, BAM16 phase )
+{
+  BAM16 turned = phase - psk->lastPhase;
+  psk->lastPhase = phase;
+
+  switch( psk->mode )
+  {
+    case PSK_BPSK:
+      return BAM16_Quad14( phase ) ? 1 : 0;
+    case PSK_QPSK:
+      return (BAM16)(phase + BAM16_45_DEGREES) >> 14;
+    case PSK_DBPSK:
+      return BAM16_Quad14( turned ) ? 1 : 0;
+    default:
+      return (BAM16)(turned + BAM16_45_DEGREES) >> 14;
+  }
+}
+
+/**
+ * Runs at each symbol strobe: timing and carrier error, then the decision.
+ */
+static void symbolStrobe( PSKDemod* psk, Complex16 y, Complex16* symbol, uint8_t* bits )
+{
+  Polar16 pol = CORDIC16_rect2polar( y );
+
+  // Gardner: the midpoint between two different symbols should be zero, and
+  // its sign against the change between them says early or late.
+  int32_t e = ((int32_t)psk->last.I - y.I) * psk->mid.I
+            + ((int32_t)psk->last.Q - y.Q) * psk->mid.Q;
+  int32_t energy = ((int32_t)pol.mag * pol.mag) >> 15;
+  if( energy > 0 )
+  {
+    psk->timing += (int16_t)constrain( e / energy, -Q15_ONE, Q15_ONE ) >> 2;
+  }
+  if( psk->timing > PSK_TIMING_STEP )
+  {
+    psk->timing -= PSK_TIMING_STEP;
+    --psk->count;   // strobe a sample later
+  }
+  else if( psk->timing < -PSK_TIMING_STEP )
+  {
+    psk->timing += PSK_TIMING_STEP;
+    ++psk->count;   // strobe a sample sooner
+  }
+  psk->last = y;
+
+  // Phase error folded into +/-90 degrees for BPSK, +/-45 for QPSK
+  bool quad = (PSK_QPSK == psk->mode) || (PSK_DQPSK == psk->mode);
+  int16_t err = quad ? ((int16_t)(pol.phase << 2)) >> 2 : ((int16_t)(pol.phase << 1)) >> 1;
+  psk->phase += err >> PSK_PHASE_SHIFT;
+  // The integral gain is per symbol, so spread it over the symbol's samples
+  psk->freqError += ((int32_t)err << (8 - PSK_FREQ_SHIFT)) / (psk->halfLength << 1);
+  psk->freqError = constrain( psk->freqError, -psk->freqLimit, psk->freqLimit );
+
+  BAM16 corrected = pol.phase - err;
+  *symbol = CORDIC16_polar2rect( { pol.mag, corrected } );
+  *bits = decide( psk, corrected );
+}
+
+bool PSKDemod_push( PSKDemod* psk, Q_15 sample, Complex16* symbol, uint8_t* bits )
+{
+  // Mix down to baseband, I = x*cos, Q = -x*sin
+  BAM8 angle = BAM16toBAM8( psk->phase );
+  psk->sumI += ((int32_t)sample * cosine_table( angle )) >> 15;
+  psk->sumQ -= ((int32_t)sample * cosine_table( angle - 64 )) >> 15;
+  psk->phase += psk->freq + (psk->freqError >> 8);
+
+  if( ++psk->count < (int16_t)psk->halfLength )
+  {
+    return false;
+  }
+  psk->count = 0;
+
+  // Integrate and dump: a symbol long boxcar sampled every half symbol
+  Complex16 now = { (Q_15)(psk->sumI >> psk->shift), (Q_15)(psk->sumQ >> psk->shift) };
+  Complex16 y = { (Q_15)(((int32_t)psk->half.I + now.I) >> 1), (Q_15)(((int32_t)psk->half.Q + now.Q) >> 1) };
+  frequencyDetector( psk, psk->half, now );
+  psk->half = now;
+  psk->sumI = 0;
+  psk->sumQ = 0;
+
+  // Boundaries alternate between symbol midpoints and symbol strobes
+  if( !psk->atSymbol )
+  {
+    psk->mid = y;
+    psk->atSymbol = true;
+    return false;
+  }
+  psk->atSymbol = false;
+
+  symbolStrobe( psk, y, symbol, bits );
+  return true;
+}
+
+BAM16 PSKDemod_carrier( PSKDemod* psk )
+{
+  return psk->freq + (psk->freqError >> 8);
+}
@@ -0,0 +1,103 @@
+/**
+ * @file    psk.h
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * BPSK and QPSK demodulator with carrier and symbol timing recovery, for
+ * PSK31 style signals.
+ *
+ *  mix to baseband -> half symbol integrate and dump -> Gardner timing
+ *                  -> CORDIC phase detector -> NCO correction -> decisions
+ *
+ * Per sample the cost is two COSINE table lookups, two multiplies and two
+ * adds. Per symbol there is one CORDIC16_rect2polar, for the phase error and
+ * the magnitude that normalizes the timing error, one division and a handful
+ * of multiplies. At 8kHz PSK31 (256 samples/symbol) the per sample work
+ * dominates; the Benchmark example reports cycles per symbol on the target.
+ *
+ * A frequency detector on each pair of half symbols pulls the carrier in
+ * before the phase loop locks. The pull-in range is a quarter of the symbol
+ * rate for BPSK/DBPSK and an eighth for QPSK/DQPSK: measured +-15Hz and
+ * +-8Hz for PSK31 (31.25 baud) at 12dB SNR in the 4kHz band. Timing from a
+ * half symbol offset takes a few hundred symbols for the QPSK modes.
+ *
+ *     Complex16 sym;
+ *     uint8_t bits;
+ *     if( PSKDemod_push( &psk, sample, &sym, &bits ) )
+ *     {
+ *       varicode( bits );
+ *     }
+ *
+ */
+#ifndef   PSK_H
+#define   PSK_H
+
+/* Includes ******************************************************************/
+#include <inttypes.h>
+#include "DSP.h"
+
+/* Defines *******************************************************************/
+
+/* Types *********************************************************************/
+typedef enum PSKMode
+{
+  PSK_BPSK,       ///< 1 bit per symbol, 1 for 0 degrees
+  PSK_QPSK,       ///< 2 bits per symbol, quadrant counterclockwise from 0 degrees
+  PSK_DBPSK,      ///< 1 bit per symbol, 0 for a phase reversal (PSK31)
+  PSK_DQPSK,      ///< 2 bits per symbol, quadrants turned since the last symbol
+} PSKMode;
+
+typedef struct PSKDemod
+{
+  BAM16     phase;     ///< carrier NCO phase
+  BAM16     freq;      ///< nominal carrier, BAM16 per sample
+  int32_t   freqError; ///< carrier loop integrator, BAM16 per sample * 2^8
+  int32_t   freqLimit; ///< largest freqError, the pull-in range
+  int32_t   sumI;      ///< integral of the current half symbol
+  int32_t   sumQ;
+  Complex16 half;      ///< integral of the previous half symbol
+  Complex16 mid;       ///< matched filter output half a symbol ago
+  Complex16 last;      ///< matched filter output a symbol ago
+  BAM16     lastPhase; ///< phase of the last symbol, for differential modes
+  int16_t   timing;    ///< timing error accumulator
+  uint16_t  halfLength;///< samples per half symbol
+  int16_t   count;     ///< samples into the current half symbol
+  uint8_t   shift;     ///< scales a symbol integral to Q_15
+  uint8_t   mode;
+  bool      atSymbol;  ///< the next half symbol boundary is a symbol strobe
+} PSKDemod;
+
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+/**
+ * Initializes a PSKDemod
+ *
+ * @param psk the PSKDemod to initialize
+ * @param carrier the carrier frequency in BAM16 per sample
+ * @param samplesPerSymbol samples in each symbol, even
+ * @param mode the modulation and bit mapping
+ */
+void PSKDemod_init( PSKDemod* psk, BAM16 carrier, uint16_t samplesPerSymbol, PSKMode mode );
+
+/**
+ * Adds one sample to the demodulator.
+ *
+ * @param psk the PSKDemod
+ * @param sample the next sample
+ * @param symbol where to write the carrier corrected symbol, if one is ready
+ * @param bits where to write the decided bits, if a symbol is ready
+ * @return true if a symbol was produced
+ */
+bool PSKDemod_push( PSKDemod* psk, Q_15 sample, Complex16* symbol, uint8_t* bits );
+
+/**
+ * Returns the recovered carrier frequency, nominal plus tracked offset.
+ *
+ * @param psk the PSKDemod
+ * @return the carrier in BAM16 per sample
+ */
+BAM16 PSKDemod_carrier( PSKDemod* psk );
+
+#endif // PSK_H
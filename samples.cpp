@@ -24,6 +24,7 @@ void SampleBuffer_init( SampleBuffer* sb)
 {
   sb->in=0;
   sb->out=0;
+  sb->next=0;
 }
 
 int SampleBuffer_size( SampleBuffer* sb)
@@ -64,6 +65,13 @@ bool SampleBuffer_full( SampleBuffer* sb)
 
 void SampleBuffer_push( SampleBuffer* sb, uint16_t sample)
 {
+  if( !(sb->in & (SAMPLE_BLOCK_SIZE - 1)) )
+  {
+    SampleStamp* stamp = &sb->stamps[sb->in / SAMPLE_BLOCK_SIZE];
+    stamp->index = sb->next;
+    stamp->time_us = micros();
+    sb->next += SAMPLE_BLOCK_SIZE;
+  }
   sb->buff[sb->in++]=sample;
 }
 
@@ -72,6 +80,17 @@ uint16_t SampleBuffer_pop( SampleBuffer* sb)
   return sb->buff[sb->out++];
 }
 
+uint32_t SampleBuffer_tell( SampleBuffer* sb, SampleStamp* stamp )
+{
+  uint8_t out = sb->out;
+
+  noInterrupts();
+  *stamp = sb->stamps[out / SAMPLE_BLOCK_SIZE];
+  interrupts();
+
+  return stamp->index + (out & (SAMPLE_BLOCK_SIZE - 1));
+}
+
 int SampleBuffer_popAllOrNothing( SampleBuffer* sb, Q_15* buf, int count)
 {
   if (SampleBuffer_size( sb ) < count)
@@ -105,10 +124,16 @@ int SampleBuffer_pushAllOrNothing( SampleBuffer* sb, Q_15* buf, int count)
 }
 
 
-void ADC_StreamSetup( int pin, int sampleTime_us)
+/**
+ * Starts Timer 1 and the ADC it triggers.
+ *
+ * @param pin which analog input to sample on
+ * @param clockSelect Timer 1 CS12:0 bits
+ * @param top Timer 1 compare value, ticks per sample - 1
+ * @param ticks the sample period in 0.5us ticks - 1, picks the ADC clock
+ */
+static void ADC_StreamStart( int pin, uint8_t clockSelect, uint16_t top, uint16_t ticks)
 {
-  uint16_t ticks = (sampleTime_us << 1) - 1;     // ticks = period * 2 ticks per us - 1 event tick
-
   if (pin >= A0)
   {
     pin -= A0;
@@ -120,10 +145,10 @@ void ADC_StreamSetup( int pin, int sampleTime_us)
   TCCR1A = 0;
   TCCR1B = 0;
   TCNT1 = 0;
-  TCCR1B = bit (CS11) | bit (WGM12);  // 16MHz clk / 8 prescaler -> 2 ticks per us
+  TCCR1B = clockSelect | bit (WGM12);
   TIMSK1 = bit (OCIE1B);
-  OCR1A = ticks;
-  OCR1B = ticks;
+  OCR1A = top;
+  OCR1B = top;
 
   // Setup ADC for auto trigger on Timer 1 B
 
@@ -195,6 +220,142 @@ void ADC_StreamSetup( int pin, int sampleTime_us)
   interrupts();
 }
 
+void ADC_StreamSetup( int pin, int sampleTime_us)
+{
+  uint16_t ticks = (sampleTime_us << 1) - 1;     // ticks = period * 2 ticks per us - 1 event tick
+
+  ADC_StreamStart( pin, bit (CS11), ticks, ticks );  // 16MHz clk / 8 prescaler -> 2 ticks per us
+}
+
+bool ADC_StreamSetupRate( int pin, uint32_t rate_Hz, StreamRate* sr )
+{
+  // Timer 1 prescales by CS12:0 = select + 1
+  static const uint16_t PRESCALES[] = { 1, 8, 64, 256, 1024 };
+  const uint8_t count = sizeof(PRESCALES) / sizeof(PRESCALES[0]);
+
+  if( !rate_Hz || F_CPU / rate_Hz < STREAM_MIN_CYCLES )
+  {
+    return false;
+  }
+
+  // Finest ticks that leave room for the long period in 16 bits
+  uint8_t select = 0;
+  uint32_t clock = F_CPU;
+  while( clock / rate_Hz >= 0xFFFF && select < count - 1 )
+  {
+    clock = F_CPU / PRESCALES[++select];
+  }
+  if( clock / rate_Hz >= 0xFFFF )
+  {
+    return false;
+  }
+
+  sr->rate = rate_Hz;
+  sr->ticks = clock / rate_Hz;
+  sr->fraction = clock % rate_Hz;
+  sr->error = 0;
+  sr->prescale = PRESCALES[select];
+
+  // rate * ticks + fraction = clock, exact unless F_CPU / prescale truncated
+  uint64_t cycles = (uint64_t)sr->prescale * ((uint64_t)sr->ticks * rate_Hz + sr->fraction);
+  sr->achieved_mHz = ((uint64_t)F_CPU * 1000 * rate_Hz + cycles / 2) / cycles;
+  sr->jitter_ns = sr->fraction ? (uint32_t)((1000000000ULL * sr->prescale) / F_CPU) : 0;
+
+  uint32_t adcTicks = (uint32_t)sr->ticks * sr->prescale / 8 - 1;
+  ADC_StreamStart( pin, select + 1, sr->ticks - 1, adcTicks > 0xFFFF ? 0xFFFF : adcTicks );
+  return true;
+}
+
+void StreamRate_step( StreamRate* sr )
+{
+  uint16_t top = sr->ticks - 1;
+
+  sr->error += sr->fraction;
+  if( sr->error >= sr->rate )
+  {
+    sr->error -= sr->rate;
+    ++top;
+  }
+
+  // CTC mode does not buffer OCR1A, so this sets the period now running
+  OCR1A = top;
+  OCR1B = top;
+}
+
+bool ADC_BurstSetup( int pin, uint8_t prescale, uint8_t decimation, StreamBurst* burst )
+{
+  uint8_t adps = 0;
+  while( (2 << adps) < prescale )
+  {
+    ++adps;
+  }
+  uint8_t shift = 0;
+  while( (1 << shift) < decimation )
+  {
+    ++shift;
+  }
+  if( prescale != (2 << adps) || adps > 6 || decimation != (1 << shift) || shift > 6 )
+  {
+    return false;
+  }
+
+  burst->sum = 0;
+  burst->count = decimation;
+  burst->decimation = decimation;
+  burst->shift = shift;
+  burst->overruns = 0;
+  burst->rate_mHz = ((uint64_t)F_CPU * 1000) / ((uint32_t)prescale * 13 * decimation);
+
+  if (pin >= A0)
+  {
+    pin -= A0;
+  }
+
+  noInterrupts();
+
+  // Timer 1 is not used
+  TIMSK1 &= ~(bit (OCIE1B));
+
+  ADMUX = bit (REFS0) | (pin & 0x07);
+  ADCSRB = 0;                                        // Free running mode
+  ADCSRA = bit (ADEN) | bit (ADIE) | bit (ADIF) | bit (ADATE) | (adps + 1);
+  ADCSRA |= bit (ADSC);                              // start the first conversion
+
+  interrupts();
+
+  return true;
+}
+
+void StreamBurst_push( StreamBurst* burst, SampleBuffer* sb )
+{
+  burst->sum += ADC;
+  if( --burst->count )
+  {
+    return;
+  }
+
+  // Center on mid scale, at most 64 * 0x200 which still fits 16 bits
+  int16_t sum = burst->sum - ((uint16_t)burst->decimation << 9);
+  burst->sum = 0;
+  burst->count = burst->decimation;
+
+  if( SampleBuffer_full( sb ) )
+  {
+    ++burst->overruns;
+    return;
+  }
+
+  // mean << 4 as ADC_readCurrentSample, keeping what the average resolves
+  if( burst->shift <= 4 )
+  {
+    SampleBuffer_push( sb, sum << (4 - burst->shift) );
+  }
+  else
+  {
+    SampleBuffer_push( sb, sum >> (burst->shift - 4) );
+  }
+}
+
 void ADC_StreamStop()
 {
   // Disable Timer 1B
@@ -210,6 +371,237 @@ Q_15 ADC_readCurrentSample( void )
   return (ADC - 0x0200) << 4;
 }
 
+void StreamMonitor_reset( StreamMonitor* sm )
+{
+  noInterrupts();
+  memset( sm, 0, sizeof(*sm) );
+  sm->period = OCR1A + 1;
+  sm->lastEntry = 0xFFFF;   // no interval yet
+  interrupts();
+}
+
+void StreamMonitor_read( StreamMonitor* sm, StreamMonitor* copy )
+{
+  noInterrupts();
+  *copy = *sm;
+  interrupts();
+}
+
+uint16_t StreamMonitor_begin( StreamMonitor* sm )
+{
+  // Timer 1 restarts at each trigger, so it is the time since the trigger
+  uint16_t entry = TCNT1;
+
+  uint8_t triggers = sm->triggers;
+  uint8_t started = triggers - sm->seen;
+  sm->seen = triggers;
+  if( started > 1 )
+  {
+    // ADC holds the newest conversion, the ones before it were lost
+    sm->missed += started - 1;
+    sm->lastEntry = 0xFFFF;
+  }
+
+  if( entry > sm->maxLatency )
+  {
+    sm->maxLatency = entry;
+  }
+
+  if( sm->lastEntry != 0xFFFF )
+  {
+    // interval - period
+    int16_t jitter = entry - sm->lastEntry;
+    uint16_t error = jitter < 0 ? -jitter : jitter;
+    uint8_t bin = 0;
+    while( error && bin < STREAM_HISTOGRAM_BINS - 1 )
+    {
+      error >>= 1;
+      ++bin;
+    }
+    ++sm->intervals[bin];
+  }
+  sm->lastEntry = entry;
+
+  return entry;
+}
+
+void StreamMonitor_push( StreamMonitor* sm, SampleBuffer* sb, uint16_t sample )
+{
+  if( SampleBuffer_full( sb ) )
+  {
+    ++sm->overruns;
+    return;
+  }
+  SampleBuffer_push( sb, sample );
+
+  uint8_t size = SampleBuffer_size( sb );
+  if( size > sm->highWater )
+  {
+    sm->highWater = size;
+  }
+}
+
+void StreamMonitor_end( StreamMonitor* sm, uint16_t start )
+{
+  uint16_t now = TCNT1;
+  if( now < start )
+  {
+    // Timer 1 restarted during the ISR
+    now += sm->period;
+  }
+  uint16_t duration = now - start;
+  if( duration > sm->maxDuration )
+  {
+    sm->maxDuration = duration;
+  }
+}
+
+int StreamMonitor_pop( StreamMonitor* sm, SampleBuffer* sb, Q_15* buf, int count )
+{
+  int popped = SampleBuffer_popAllOrNothing( sb, buf, count );
+  if( !popped && count )
+  {
+    noInterrupts();
+    ++sm->underruns;
+    interrupts();
+  }
+  return popped;
+}
+
+bool SampleTrigger_init( SampleTrigger* st, TriggerMode mode, Q_15 level, Q_15 hysteresis,
+                         uint8_t pre, uint8_t post, uint16_t holdoff )
+{
+  if( !post || pre + post >= SAMPLE_BUFFER_SIZE )
+  {
+    return false;
+  }
+
+  int32_t rearm = (mode == TRIGGER_FALLING) ? (int32_t)level + hysteresis
+                                            : (int32_t)level - hysteresis;
+
+  noInterrupts();
+  st->state = TRIGGER_STOPPED;
+  st->mode = mode;
+  st->level = level;
+  st->rearm = constrain( rearm, -32768L, 32767L );
+  st->pre = pre;
+  st->post = post;
+  st->holdoff = holdoff;
+  st->since = 0xFFFF;
+  interrupts();
+
+  return true;
+}
+
+void SampleTrigger_arm( SampleTrigger* st, SampleBuffer* sb )
+{
+  noInterrupts();
+  sb->out = sb->in;
+  st->primed = false;
+  st->filled = 0;
+  st->state = TRIGGER_ARMED;
+  interrupts();
+}
+
+/**
+ * Runs the trigger condition on one sample.
+ *
+ * @param st the SampleTrigger
+ * @param sample the sample
+ * @return true if the sample fires the trigger
+ */
+static bool SampleTrigger_hit( SampleTrigger* st, Q_15 sample )
+{
+  bool primed = st->primed;
+
+  // A crossing uses up the edge even when history or holdoff blocks it
+  switch( st->mode )
+  {
+    case TRIGGER_RISING:
+      if( sample < st->rearm )
+      {
+        st->primed = true;
+      }
+      else if( sample >= st->level )
+      {
+        st->primed = false;
+        return primed;
+      }
+      return false;
+
+    case TRIGGER_FALLING:
+      if( sample > st->rearm )
+      {
+        st->primed = true;
+      }
+      else if( sample <= st->level )
+      {
+        st->primed = false;
+        return primed;
+      }
+      return false;
+
+    case TRIGGER_ABOVE:
+      return sample >= st->level;
+
+    default: // TRIGGER_BELOW
+      return sample <= st->level;
+  }
+}
+
+void SampleTrigger_push( SampleTrigger* st, SampleBuffer* sb, Q_15 sample )
+{
+  if( st->since != 0xFFFF )
+  {
+    ++st->since;
+  }
+
+  if( st->state == TRIGGER_ARMED )
+  {
+    bool hit = SampleTrigger_hit( st, sample );
+    SampleBuffer_push( sb, sample );
+
+    if( hit && st->filled >= st->pre && st->since >= st->holdoff )
+    {
+      st->since = 0;
+      st->start = sb->in - 1 - st->pre;
+      st->remaining = st->post - 1;
+      st->state = TRIGGER_FIRED;
+    }
+    else if( st->filled < st->pre )
+    {
+      ++st->filled;
+    }
+  }
+  else if( st->state == TRIGGER_FIRED )
+  {
+    SampleBuffer_push( sb, sample );
+    --st->remaining;
+  }
+  else
+  {
+    // stopped or frozen
+    return;
+  }
+
+  if( st->state == TRIGGER_FIRED && !st->remaining )
+  {
+    // Freeze, the window is everything left in the SampleBuffer
+    sb->out = st->start;
+    st->state = TRIGGER_DONE;
+  }
+}
+
+bool SampleTrigger_done( SampleTrigger* st )
+{
+  return st->state == TRIGGER_DONE;
+}
+
+Q_15 SampleTrigger_at( SampleTrigger* st, SampleBuffer* sb, int i )
+{
+  return sb->buff[(uint8_t)(st->start + st->pre + i)];
+}
+
 int getSamples( int pin, Q_15* buf, int count, int sampleTime_us)
 {
   if(sampleTime_us < PERIOD_US_8KHZ)
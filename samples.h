@@ -26,6 +26,12 @@
 // FIXED SIZE allows for a lot of optimizations vs parameterized size.
 #define SAMPLE_BUFFER_SIZE 256
 
+// Samples per timestamped block, a power of 2 dividing SAMPLE_BUFFER_SIZE
+#ifndef SAMPLE_BLOCK_SIZE
+#define SAMPLE_BLOCK_SIZE 32
+#endif
+#define SAMPLE_BLOCKS (SAMPLE_BUFFER_SIZE / SAMPLE_BLOCK_SIZE)
+
 #define PERIOD_US_8KHZ 125
 #define PERIOD_US_6666HZ 150
 #define PERIOD_US_5KHZ 200
@@ -33,14 +39,137 @@
 #define PERIOD_US_3333HZ 300
 #define PERIOD_US_2KHZ 500
 
+// Fewest CPU cycles per sample ADC_StreamSetupRate accepts, the ADC_StreamSetup limit
+#define STREAM_MIN_CYCLES 40
+
+// Sample interval histogram bins, see StreamMonitor
+#define STREAM_HISTOGRAM_BINS 8
+
 /* Types *********************************************************************/
+
+/**
+ * Where a block of samples sits in the stream: the absolute index of its
+ * first sample, counting every sample pushed since SampleBuffer_init, and
+ * micros() when that sample was pushed.
+ */
+typedef struct SampleStamp
+{
+  uint32_t index;
+  uint32_t time_us;
+} SampleStamp;
+
 typedef struct SampleBuffer
 {
   uint16_t buff[SAMPLE_BUFFER_SIZE];
   uint8_t in;
   uint8_t out;
+  uint32_t next;                      // index of the next block to start
+  SampleStamp stamps[SAMPLE_BLOCKS];  // one per SAMPLE_BLOCK_SIZE slots
 } SampleBuffer;
 
+/**
+ * What fires a SampleTrigger. The edge modes only fire once the signal has
+ * been beyond level by more than the hysteresis, so noise riding on a slow
+ * crossing fires once rather than on every wiggle.
+ */
+typedef enum TriggerMode
+{
+  TRIGGER_RISING,   // rises to level after being below level - hysteresis
+  TRIGGER_FALLING,  // falls to level after being above level + hysteresis
+  TRIGGER_ABOVE,    // any sample at or above level
+  TRIGGER_BELOW     // any sample at or below level
+} TriggerMode;
+
+typedef enum TriggerState
+{
+  TRIGGER_STOPPED,  // samples are ignored
+  TRIGGER_ARMED,    // recording history, waiting for the trigger
+  TRIGGER_FIRED,    // recording the samples after the trigger
+  TRIGGER_DONE      // window frozen in the SampleBuffer
+} TriggerState;
+
+/**
+ * Oscilloscope style capture in a SampleBuffer. While armed the buffer is a
+ * ring of history overwritten by every sample. When the trigger fires, post
+ * more samples are pushed from the trigger sample on, then the buffer is
+ * frozen with the pre samples before the trigger still in it, and in and
+ * out set to bracket the window. Nothing is copied.
+ */
+typedef struct SampleTrigger
+{
+  Q_15     level;
+  Q_15     rearm;         // edge modes: primed beyond this, level -/+ hysteresis
+  uint8_t  mode;          // TriggerMode
+  uint8_t  pre;           // samples kept before the trigger sample
+  uint8_t  post;          // samples kept from the trigger sample on
+  uint16_t holdoff;       // fewest samples from one trigger to the next
+  volatile uint8_t state; // TriggerState
+  bool     primed;        // edge modes: the signal was beyond rearm
+  uint8_t  filled;        // history pushed since arming, up to pre
+  uint8_t  remaining;     // post samples still to push
+  uint8_t  start;         // buffer slot of the first sample of the window
+  uint16_t since;         // samples since the last trigger, saturating
+} SampleTrigger;
+
+/**
+ * A sample rate in Hz held exactly on average by Timer 1. The period is rarely
+ * a whole number of ticks, so StreamRate_step alternates the compare value,
+ * Bresenham style, giving fraction long periods of ticks + 1 in every rate
+ * periods and ticks in the rest. The mean period is then exactly
+ * (F_CPU / prescale) / rate ticks, at the cost of one tick of jitter.
+ */
+typedef struct StreamRate
+{
+  uint32_t rate;          // samples per second, the Bresenham denominator
+  uint32_t fraction;      // long periods per rate periods
+  uint32_t error;         // Bresenham accumulator, below rate
+  uint16_t ticks;         // short period in Timer 1 ticks
+  uint16_t prescale;      // CPU cycles per Timer 1 tick
+  uint32_t achieved_mHz;  // mean sample rate achieved, in millihertz
+  uint16_t jitter_ns;     // long period - short period, 0 when exact
+} StreamRate;
+
+/**
+ * A free running ADC burst, averaged down in its ISR. Each output sample is
+ * the mean of decimation conversions, which lowers the noise as well as the
+ * rate: averaging 4^k conversions of noisy input gains about k bits.
+ */
+typedef struct StreamBurst
+{
+  uint16_t sum;           // conversions so far, 10 bits each
+  uint8_t  count;         // conversions still to add
+  uint8_t  decimation;    // conversions per sample, a power of 2 up to 64
+  uint8_t  shift;         // log2 decimation
+  uint16_t overruns;      // samples dropped because the SampleBuffer was full
+  uint32_t rate_mHz;      // output sample rate, in millihertz
+} StreamBurst;
+
+/**
+ * Deadline statistics for an ADC stream, kept by a few calls in its ISRs.
+ * Times are in Timer 1 ticks, 0.5us each after ADC_StreamSetup or
+ * StreamRate.prescale cycles after ADC_StreamSetupRate, counted from the
+ * Timer 1 compare match that triggered the conversion.
+ *
+ * The sample interval histogram counts |interval - period| on a log scale:
+ * bin 0 is exact, bin 1 is 1 tick off, bin 2 is 2-3 ticks, bin 3 is 4-7,
+ * and so on, with the last bin taking everything larger. The counts are 32
+ * bits so they last a day of streaming at 44.1kHz without wrapping.
+ */
+typedef struct StreamMonitor
+{
+  volatile uint8_t triggers;   // conversions started, see StreamMonitor_trigger
+  uint8_t  seen;               // triggers the ADC ISR has accounted for
+  uint8_t  highWater;          // most samples ever waiting in the SampleBuffer
+  uint16_t period;             // ticks per sample
+  uint16_t lastEntry;          // ticks into the period the last ADC ISR started
+  uint32_t overruns;           // samples dropped because the SampleBuffer was full
+  uint32_t missed;             // conversions overwritten before the ADC ISR ran
+  uint32_t underruns;          // pops that found too few samples
+  uint16_t maxLatency;         // longest trigger to ADC ISR start
+  uint16_t maxDuration;        // longest ADC ISR, StreamMonitor_begin to _end
+  uint32_t intervals[STREAM_HISTOGRAM_BINS];
+} StreamMonitor;
+
 /* Interfaces ****************************************************************/
 /* Data **********************************************************************/
 /* Functions *****************************************************************/
@@ -85,10 +214,12 @@ bool SampleBuffer_empty( SampleBuffer* sb);
 bool SampleBuffer_full( SampleBuffer* sb);
 
 /**
- * [Description]
+ * Pushes a sample. The first sample of every SAMPLE_BLOCK_SIZE block also
+ * stamps the block with its index and time, so the cost per sample stays a
+ * single test.
  *
- * @param
- * @return
+ * @param sb the SampleBuffer
+ * @param sample the sample to push
  */
 void SampleBuffer_push( SampleBuffer* sb, uint16_t sample);
 
@@ -100,6 +231,24 @@ void SampleBuffer_push( SampleBuffer* sb, uint16_t sample);
  */
 uint16_t SampleBuffer_pop( SampleBuffer* sb);
 
+/**
+ * Finds where the next sample to pop sits in the stream, so a popped span
+ * can be mapped to absolute sample indexes and times:
+ *
+ *     index of popped sample i = returned index + i
+ *     time of popped sample i ~= stamp.time_us + (index + i - stamp.index) * period
+ *
+ * The stamp time is when the ISR pushed the sample, after the conversion
+ * by the ISR latency. Only valid while the SampleBuffer is not empty and
+ * holds fewer than SAMPLE_BUFFER_SIZE - SAMPLE_BLOCK_SIZE samples, beyond
+ * which the block being read may already be stamped again.
+ *
+ * @param sb the SampleBuffer
+ * @param stamp set to the stamp of the block holding the next sample
+ * @return the absolute index of the next sample to pop
+ */
+uint32_t SampleBuffer_tell( SampleBuffer* sb, SampleStamp* stamp );
+
 /**
  * If the SampleBuffer has free space for  at least count samples it will push
  * that many from buf, otherwise it will only return 0.
@@ -144,6 +293,70 @@ int SampleBuffer_popAllOrNothing( SampleBuffer* sb, Q_15* buf, int count);
  */
 void ADC_StreamSetup( int pin, int sampleTime_us);
 
+/**
+ * ADC_StreamSetup for a sample rate in Hz, such as 11025 or 8820, that is not
+ * a whole number of microseconds. Timer 1 runs at the fastest prescale that
+ * fits the period, for the finest ticks, and the TIMER1_COMPB_vect ISR must
+ * step the compare value to hold the mean rate:
+ *
+ *     ISR(TIMER1_COMPB_vect)
+ *     {
+ *       StreamRate_step(&myRate);
+ *     }
+ *
+ * Without it every period is the short one and the rate is slightly high.
+ *
+ * @param pin which analog input to sample on
+ * @param rate_Hz samples per second
+ * @param sr set to the Timer 1 setup, the achieved rate and jitter
+ * @return false, with the stream not started, if rate_Hz is 0 or leaves
+ *         fewer than STREAM_MIN_CYCLES per sample
+ */
+bool ADC_StreamSetupRate( int pin, uint32_t rate_Hz, StreamRate* sr );
+
+/**
+ * Sets the length of the Timer 1 period just started, from the
+ * TIMER1_COMPB_vect ISR of a stream set up by ADC_StreamSetupRate. Timer 1
+ * must not have passed the short period yet, which only happens when the
+ * ISR is held off for a whole sample.
+ *
+ * @param sr the StreamRate from ADC_StreamSetupRate
+ */
+void StreamRate_step( StreamRate* sr );
+
+/**
+ * Samples as fast as the ADC clock allows, free running without Timer 1, and
+ * averages decimation conversions into each sample pushed:
+ *
+ *     ISR (ADC_vect)
+ *     {
+ *       StreamBurst_push(&myBurst, &mySampleBuffer);
+ *     }
+ *
+ * A conversion takes 13 ADC clocks, so at 16MHz a prescale of 16 converts
+ * at 76.9kHz, 208 CPU cycles each, which the ISR must fit in. 8 and below
+ * are faster but lose accuracy, the ADC is specified up to a 200kHz clock
+ * for 10 bits. Stop with ADC_StreamStop.
+ *
+ * @param pin which analog input to sample on
+ * @param prescale ADC clock divider, a power of 2 from 2 to 128
+ * @param decimation conversions per sample, a power of 2 from 1 to 64
+ * @param burst set to the burst state and output rate
+ * @return false, with the ADC not started, for an invalid prescale or
+ *         decimation
+ */
+bool ADC_BurstSetup( int pin, uint8_t prescale, uint8_t decimation, StreamBurst* burst );
+
+/**
+ * Adds the current conversion to the average and pushes a sample, scaled as
+ * ADC_readCurrentSample, every decimation conversions. Drops the sample and
+ * counts an overrun when the SampleBuffer is full.
+ *
+ * @param burst the StreamBurst from ADC_BurstSetup
+ * @param sb the SampleBuffer
+ */
+void StreamBurst_push( StreamBurst* burst, SampleBuffer* sb );
+
 /**
  * Stops the ADC sample stream
  *
@@ -159,6 +372,148 @@ void ADC_StreamStop(void);
  */
 Q_15 ADC_readCurrentSample( void );
 
+/**
+ * Clears the statistics of a running stream. Call after ADC_StreamSetup, it
+ * reads the sample period from Timer 1. Safe while the stream runs.
+ *
+ *     ISR(TIMER1_COMPB_vect)
+ *     {
+ *       StreamMonitor_trigger(&myMonitor);  // optional, to count missed samples
+ *     }
+ *
+ *     ISR (ADC_vect)
+ *     {
+ *       uint16_t start = StreamMonitor_begin(&myMonitor);
+ *       StreamMonitor_push(&myMonitor, &mySampleBuffer, ADC_readCurrentSample());
+ *       StreamMonitor_end(&myMonitor, start);
+ *     }
+ *
+ * and in the main loop StreamMonitor_pop in place of
+ * SampleBuffer_popAllOrNothing.
+ *
+ * @param sm the StreamMonitor
+ */
+void StreamMonitor_reset( StreamMonitor* sm );
+
+/**
+ * Copies the statistics with interrupts off so they are consistent.
+ *
+ * @param sm the StreamMonitor
+ * @param copy where to copy it
+ */
+void StreamMonitor_read( StreamMonitor* sm, StreamMonitor* copy );
+
+/**
+ * Counts a conversion trigger, from the TIMER1_COMPB_vect ISR. Without it
+ * missed samples are not counted.
+ *
+ * @param SM pointer to the StreamMonitor
+ */
+#define StreamMonitor_trigger(SM) (++(SM)->triggers)
+
+/**
+ * Starts timing the ADC ISR, first thing in ADC_vect. Records the latency
+ * from the trigger, the interval since the last sample and missed samples.
+ *
+ * @param sm the StreamMonitor
+ * @return the start time to pass to StreamMonitor_end
+ */
+uint16_t StreamMonitor_begin( StreamMonitor* sm );
+
+/**
+ * Pushes a sample unless the SampleBuffer is full, which counts an overrun
+ * instead of overwriting the oldest samples. Tracks the high water mark.
+ *
+ * @param sm the StreamMonitor
+ * @param sb the SampleBuffer
+ * @param sample the sample to push
+ */
+void StreamMonitor_push( StreamMonitor* sm, SampleBuffer* sb, uint16_t sample );
+
+/**
+ * Stops timing the ADC ISR, last thing in ADC_vect.
+ *
+ * @param sm the StreamMonitor
+ * @param start from StreamMonitor_begin
+ */
+void StreamMonitor_end( StreamMonitor* sm, uint16_t start );
+
+/**
+ * SampleBuffer_popAllOrNothing, counting an underrun when there are not
+ * enough samples. Call it when the samples are due, a loop polling for
+ * samples should check SampleBuffer_size first.
+ *
+ * @param sm the StreamMonitor
+ * @param sb the SampleBuffer
+ * @param buf destination buffer for popped samples
+ * @param count number of samples to pop
+ * @return number of samples popped
+ */
+int StreamMonitor_pop( StreamMonitor* sm, SampleBuffer* sb, Q_15* buf, int count );
+
+/**
+ * Sets up a trigger, stopped. Arm it with SampleTrigger_arm. The window is
+ * pre + post samples with the trigger sample at SampleTrigger_at( st, sb, 0 ).
+ *
+ * @param st the SampleTrigger
+ * @param mode a TriggerMode
+ * @param level the trigger level
+ * @param hysteresis how far beyond level the edge modes need the signal to
+ *        go before they can fire, 0 for a plain crossing
+ * @param pre samples to keep before the trigger sample
+ * @param post samples to keep from the trigger sample on, at least 1
+ * @param holdoff fewest samples from one trigger to the next, which keeps
+ *        the same event from firing a re-armed trigger again
+ * @return false if post is 0 or the window does not fit in the SampleBuffer
+ */
+bool SampleTrigger_init( SampleTrigger* st, TriggerMode mode, Q_15 level, Q_15 hysteresis,
+                         uint8_t pre, uint8_t post, uint16_t holdoff );
+
+/**
+ * Empties the SampleBuffer and waits for the trigger. The trigger can not
+ * fire until pre samples of history are in. Safe while the stream runs.
+ *
+ * @param st the SampleTrigger
+ * @param sb the SampleBuffer it captures into
+ */
+void SampleTrigger_arm( SampleTrigger* st, SampleBuffer* sb );
+
+/**
+ * Pushes a sample and runs the trigger, in ADC_vect in place of
+ * SampleBuffer_push:
+ *
+ *     ISR (ADC_vect)
+ *     {
+ *       SampleTrigger_push(&myTrigger, &mySampleBuffer, ADC_readCurrentSample());
+ *     }
+ *
+ * Nothing may pop the SampleBuffer until SampleTrigger_done. Afterwards
+ * SampleBuffer_size is the window size and popping reads it in order, and
+ * SampleBuffer_tell gives its stream index while the window is no larger
+ * than SAMPLE_BUFFER_SIZE - SAMPLE_BLOCK_SIZE.
+ *
+ * @param st the SampleTrigger
+ * @param sb the SampleBuffer
+ * @param sample the sample to push
+ */
+void SampleTrigger_push( SampleTrigger* st, SampleBuffer* sb, Q_15 sample );
+
+/**
+ * @param st the SampleTrigger
+ * @return true once the window is frozen
+ */
+bool SampleTrigger_done( SampleTrigger* st );
+
+/**
+ * Reads the frozen window in place.
+ *
+ * @param st the SampleTrigger, SampleTrigger_done
+ * @param sb the SampleBuffer
+ * @param i sample relative to the trigger sample, -pre to post - 1
+ * @return the sample
+ */
+Q_15 SampleTrigger_at( SampleTrigger* st, SampleBuffer* sb, int i );
+
 /**
  * An un-buffered blocking way to read a collection of sampled analog data from an analog input.
  * This is a attempt to limit the calls to only standard Arduino APIs, avoiding hw specific
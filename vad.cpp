@@ -0,0 +1,135 @@
+/**
+ * @file    vad.cpp
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * A cheap per sample activity detector used to gate the expensive spectral
+ * stages.
+ *
+ */
+
+/* Includes ******************************************************************/
+#include "vad.h"
+
+#include <Arduino.h>
+
+/* Defines *******************************************************************/
+// Lowest noise floor, about the quantization noise of the 10 bit ADC
+#define VAD_MIN_NOISE 0x400UL
+
+// Default hiss limit, 1 crossing per 3 samples is well above voiced speech
+#define VAD_DEFAULT_ZCR_LIMIT 0x5555
+
+/* Types *********************************************************************/
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+void VAD_init( VAD* vad, int energyShift, uint16_t factorQ4, uint16_t hangover )
+{
+  vad->energy = 0;
+  vad->noise = VAD_MIN_NOISE;
+  vad->threshold = 0xFFFFFFFFUL;
+  vad->zcr = 0;
+  vad->zcrLimit = VAD_DEFAULT_ZCR_LIMIT;
+  vad->factor = factorQ4 ? factorQ4 : VAD_DEFAULT_FACTOR_Q4;
+  vad->hangover = hangover;
+  vad->hold = 0;
+  vad->energyShift = energyShift;
+  vad->noiseShift = energyShift + 4;
+  vad->warmup = 2 << energyShift;
+  vad->tick = 0;
+  vad->last = 0;
+  vad->active = false;
+}
+
+/**
+ * Tracks the noise floor and sets the threshold from it. The floor follows
+ * the energy straight down but only creeps up, slower still while active, so
+ * it settles on the quiet gaps between signals.
+ */
+static void update( VAD* vad )
+{
+  if( vad->warmup )
+  {
+    vad->noise = vad->energy;
+  }
+  else if( vad->energy < vad->noise )
+  {
+    vad->noise = vad->energy;
+  }
+  else
+  {
+    uint8_t shift = vad->active ? vad->noiseShift + 4 : vad->noiseShift;
+    vad->noise += (vad->energy - vad->noise) >> shift;
+  }
+  if( vad->noise < VAD_MIN_NOISE )
+  {
+    vad->noise = VAD_MIN_NOISE;
+  }
+
+  // threshold = noise * factor, saturating
+  uint32_t scaled = vad->noise >> 4;
+  if( scaled > 0xFFFFFFFFUL / vad->factor )
+  {
+    vad->threshold = 0xFFFFFFFFUL;
+  }
+  else
+  {
+    vad->threshold = scaled * vad->factor;
+  }
+}
+
+bool VAD_push( VAD* vad, Q_15 sample )
+{
+  // Leaky averages of x^2 and of sign changes
+  int32_t power = (int32_t)sample * sample;
+  vad->energy += (power - (int32_t)vad->energy) >> vad->energyShift;
+  UQ_16 crossed = ((sample ^ vad->last) < 0) ? 0xFFFF : 0;
+  vad->zcr += ((int32_t)crossed - vad->zcr) >> vad->energyShift;
+  vad->last = sample;
+
+  if( ++vad->tick >= VAD_UPDATE_INTERVAL )
+  {
+    vad->tick = 0;
+    update( vad );
+    if( vad->warmup )
+    {
+      vad->warmup = (vad->warmup > VAD_UPDATE_INTERVAL) ? vad->warmup - VAD_UPDATE_INTERVAL : 0;
+      return false;
+    }
+  }
+
+  // Hiss has to clear twice the threshold
+  uint32_t energy = (vad->zcr > vad->zcrLimit) ? vad->energy >> 1 : vad->energy;
+  if( !vad->warmup && energy > vad->threshold )
+  {
+    vad->hold = vad->hangover;
+    vad->active = true;
+  }
+  else if( vad->hold )
+  {
+    --vad->hold;
+  }
+  else
+  {
+    vad->active = false;
+  }
+
+  return vad->active;
+}
+
+bool VAD_pushBlock( VAD* vad, const Q_15* buf, int count )
+{
+  bool any = false;
+  while( count-- )
+  {
+    any |= VAD_push( vad, *buf++ );
+  }
+  return any;
+}
+
+bool VAD_active( VAD* vad )
+{
+  return vad->active;
+}
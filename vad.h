@@ -0,0 +1,92 @@
+/**
+ * @file    vad.h
+ * @author  Ted Kotz <ted@kotz.us>
+ * @version 0.1
+ *
+ * A cheap per sample activity detector used to gate the expensive spectral
+ * stages. Short term energy is compared against a CFAR style threshold, a
+ * multiple of an adaptive noise floor, and the zero crossing rate is used to
+ * ask more of hiss-like signals.
+ *
+ *     if( VAD_pushBlock( &vad, buf, 1<<order ) )
+ *     {
+ *       FFT_magnitude( spectrum, buf, order );
+ *     }
+ *
+ */
+#ifndef   VAD_H
+#define   VAD_H
+
+/* Includes ******************************************************************/
+#include <inttypes.h>
+#include "DSP.h"
+
+/* Defines *******************************************************************/
+// Samples between noise floor and threshold updates
+#define VAD_UPDATE_INTERVAL 16
+
+// Defaults for VAD_init, about 6dB over the noise floor
+#define VAD_DEFAULT_FACTOR_Q4 64
+
+/* Types *********************************************************************/
+typedef struct VAD
+{
+  uint32_t energy;      ///< short term mean square, Q_30
+  uint32_t noise;       ///< adaptive noise floor, Q_30
+  uint32_t threshold;   ///< energy needed to be active, Q_30
+  UQ_16    zcr;         ///< zero crossings per sample
+  UQ_16    zcrLimit;    ///< above this the signal is treated as hiss
+  uint16_t factor;      ///< threshold over noise floor, UQ12_4
+  uint16_t hangover;    ///< samples to stay active after the signal drops
+  uint16_t hold;        ///< samples of hangover left
+  uint16_t warmup;      ///< samples left before decisions are made
+  uint8_t  energyShift; ///< energy averages over 2^energyShift samples
+  uint8_t  noiseShift;  ///< noise floor rises over 2^noiseShift updates
+  uint8_t  tick;        ///< samples since the last update
+  Q_15     last;        ///< previous sample for zero crossings
+  bool     active;
+} VAD;
+
+/* Interfaces ****************************************************************/
+/* Data **********************************************************************/
+/* Functions *****************************************************************/
+
+/**
+ * Initializes a VAD
+ *
+ * @param vad the VAD to initialize
+ * @param energyShift energy averages over 2^energyShift samples, ~5 for 4ms at 8kHz
+ * @param factorQ4 threshold as a multiple of the noise floor in 1/16ths, sets the false alarm rate
+ * @param hangover samples to stay active after the signal drops below threshold
+ */
+void VAD_init( VAD* vad, int energyShift, uint16_t factorQ4, uint16_t hangover );
+
+/**
+ * Updates the detector with one sample. Cheap enough to call from the
+ * ADC_vect.
+ *
+ * @param vad the VAD
+ * @param sample the next sample
+ * @return true while signal is present
+ */
+bool VAD_push( VAD* vad, Q_15 sample );
+
+/**
+ * Updates the detector with a block of samples.
+ *
+ * @param vad the VAD
+ * @param buf the samples
+ * @param count the number of samples in buf
+ * @return true if signal was present in any part of the block
+ */
+bool VAD_pushBlock( VAD* vad, const Q_15* buf, int count );
+
+/**
+ * Returns the current decision without adding samples.
+ *
+ * @param vad the VAD
+ * @return true while signal is present
+ */
+bool VAD_active( VAD* vad );
+
+#endif // VAD_H